@@ -0,0 +1,452 @@
+#ifndef QL_BATCHPATHGENERATOR_HPP
+#define QL_BATCHPATHGENERATOR_HPP
+
+#include <ql/math/distributions/normaldistribution.hpp>
+#include <ql/methods/montecarlo/brownianbridge.hpp>
+#include <ql/timegrid.hpp>
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "constantblackscholesprocess.hpp"
+#include "mcprofiler.hpp"
+#include "simdkernels.hpp"
+#include "streamingstatistics.hpp"
+
+namespace QuantLib {
+
+    //! Block of paths stored node by node (structure of arrays)
+    /*! value(i,p) is the value of the p-th path at the i-th node of the
+        time grid; node(i) points to the values of all the paths of the
+        block at that node, which are contiguous in memory.
+    */
+    class PathBlock {
+      public:
+        PathBlock(TimeGrid timeGrid, Size capacity)
+        : timeGrid_(std::move(timeGrid)), capacity_(capacity), size_(0),
+          values_(timeGrid_.size() * capacity), weights_(capacity, 1.0) {}
+        //! number of nodes of each path, as in Path::length()
+        Size length() const { return timeGrid_.size(); }
+        //! number of paths currently in the block
+        Size size() const { return size_; }
+        Size capacity() const { return capacity_; }
+        const TimeGrid& timeGrid() const { return timeGrid_; }
+        const Real* node(Size i) const { return &values_[i * capacity_]; }
+        Real* node(Size i) { return &values_[i * capacity_]; }
+        Real value(Size i, Size p) const { return values_[i * capacity_ + p]; }
+        const Real* weights() const { return &weights_[0]; }
+        Real* weights() { return &weights_[0]; }
+        void resize(Size paths) {
+            QL_REQUIRE(paths <= capacity_,
+                       "block capacity (" << capacity_ << ") exceeded");
+            size_ = paths;
+        }
+      private:
+        TimeGrid timeGrid_;
+        Size capacity_, size_;
+        std::vector<Real> values_, weights_;
+    };
+
+    //! Path pricer working on a whole block of paths
+    class BatchPathPricer {
+      public:
+        virtual ~BatchPathPricer() = default;
+        //! writes the discounted payoff of the p-th path into values[p]
+        virtual void operator()(const PathBlock& paths,
+                                Real* values) const = 0;
+    };
+
+    //! How the normals of a block of paths are drawn
+    /*! With moment matching, the normals of each step are shifted and
+        rescaled over the block so that their sample mean and variance
+        are exactly 0 and 1.  With k strata, the terminal Brownian value
+        of the p-th path of a block is drawn in the (p mod k)-th of k
+        equiprobable strata and the path is filled in by the Brownian
+        bridge, whatever the brownianBridge flag.
+
+        The paths of a group (the block with moment matching, k
+        consecutive paths with stratification) are not independent: the
+        error is estimated from the group averages.
+    */
+    struct BatchSampling {
+        bool momentMatching = false;
+        Size strata = 0;
+
+        bool plain() const { return !momentMatching && strata <= 1; }
+        //! paths drawn together, whose average is an independent sample
+        Size groupSize(Size batchSize) const {
+            return momentMatching ? batchSize : std::max<Size>(strata, 1);
+        }
+    };
+
+    //! checks that a sampling scheme can be used with a batch size
+    inline void checkBatchSampling(const BatchSampling& sampling,
+                                   Size batchSize) {
+        QL_REQUIRE(sampling.plain() || batchSize > 0,
+                   "moment matching and stratification require "
+                   "batch simulation");
+        QL_REQUIRE(!sampling.momentMatching || batchSize != 1,
+                   "moment matching requires at least two paths per batch");
+        QL_REQUIRE(sampling.strata <= 1 || batchSize % sampling.strata == 0,
+                   "batch size (" << batchSize << ") must be a multiple "
+                   "of the number of strata (" << sampling.strata << ")");
+    }
+
+    //! Batch path generator for ConstantBlackScholesProcess
+    /*! Normals are drawn path by path from GSG, exactly as PathGenerator
+        does, and stored node by node.  The log-spot increments
+        (r-q-sigma^2/2)dt + sigma*sqrt(dt)*w are then accumulated one node
+        at a time over the whole block, and the exponential is taken with
+        the vectorized vectorExp() kernel.  The normals can be moment
+        matched or stratified, see BatchSampling; next() must then be
+        asked for whole groups of paths.
+
+        In single precision, the normals, the log-returns and their
+        exponential are floats (twice the SIMD lanes) and the spots are
+        converted back to Real; the log-returns are summed with a Kahan
+        compensation per path, so that the rounding error does not grow
+        with the number of steps.  Pricing and accumulation stay in Real.
+    */
+    template <class GSG>
+    class ConstantBSBatchPathGenerator {
+      public:
+        typedef GSG generator_type;
+
+        ConstantBSBatchPathGenerator(const ConstantBlackScholesProcess& process,
+                                     const TimeGrid& timeGrid,
+                                     GSG generator,
+                                     bool brownianBridge,
+                                     Size batchSize,
+                                     BatchSampling sampling = BatchSampling(),
+                                     bool singlePrecision = false);
+        //! draws the next \c paths paths (at most batchSize())
+        const PathBlock& next(Size paths) const;
+        //! antithetic paths of the last block returned by next()
+        const PathBlock& antithetic() const;
+        Size batchSize() const { return block_.capacity(); }
+        //! paths whose average is an independent sample
+        Size groupSize() const { return sampling_.groupSize(batchSize()); }
+        const TimeGrid& timeGrid() const { return block_.timeGrid(); }
+        //! time spent drawing normals and building paths (QL_MC_PROFILE)
+        const McProfile& profile() const { return profile_; }
+      private:
+        // normals of the current block, node by node, into dw_
+        void draw() const;
+        // exact mean and variance of the normals of each step
+        void matchMoments() const;
+        void build(Real sign) const;
+        void buildSingle(Real sign) const;
+        GSG generator_;
+        bool brownianBridge_;
+        BrownianBridge bb_;
+        BatchSampling sampling_;
+        bool singlePrecision_;
+        CumulativeNormalDistribution phi_;
+        InverseCumulativeNormal inversePhi_;
+        Real x0_, logX0_;
+        std::vector<Real> drift_, stdDev_;
+        mutable std::vector<Real> dw_, temp_, z_;
+        // single precision: normals, log-returns and compensations
+        mutable std::vector<float> dwf_, logReturns_, compensation_;
+        mutable PathBlock block_;
+        mutable McProfile profile_;
+    };
+
+    //! Monte Carlo model over blocks of paths
+    /*! Provides the addSamples()/sampleAccumulator() interface used by
+        simulateSamples() and ParallelMonteCarloModel.  As in
+        MonteCarloModel, an optional control variate adds
+        cvOptionValue - cvPathPricer(path) to each sample.  When the
+        generator draws dependent groups of paths, the samples are
+        rounded up to whole groups and the group averages are also
+        accumulated in groupStatistics(), from which the error is
+        estimated.
+    */
+    template <class RNG, class S>
+    class BatchMonteCarloModel {
+      public:
+        typedef S stats_type;
+        typedef ConstantBSBatchPathGenerator<typename RNG::rsg_type>
+            path_generator_type;
+
+        BatchMonteCarloModel(
+                      ext::shared_ptr<path_generator_type> pathGenerator,
+                      ext::shared_ptr<BatchPathPricer> pathPricer,
+                      bool antitheticVariate,
+                      ext::shared_ptr<BatchPathPricer> cvPathPricer =
+                          ext::shared_ptr<BatchPathPricer>(),
+                      Real cvOptionValue = 0.0)
+        : pathGenerator_(std::move(pathGenerator)),
+          pathPricer_(std::move(pathPricer)),
+          antitheticVariate_(antitheticVariate),
+          cvPathPricer_(std::move(cvPathPricer)),
+          cvOptionValue_(cvOptionValue),
+          values_(pathGenerator_->batchSize()),
+          antitheticValues_(antitheticVariate ? pathGenerator_->batchSize() : 0),
+          cvValues_(cvPathPricer_ ? pathGenerator_->batchSize() : 0) {}
+        void addSamples(Size samples);
+        const S& sampleAccumulator() const { return sampleAccumulator_; }
+        //! averages of the groups of paths; empty for independent paths
+        const StreamingStatistics& groupStatistics() const { return groups_; }
+        McProfile profile() const {
+            McProfile profile = profile_;
+            profile += pathGenerator_->profile();
+            return profile;
+        }
+      private:
+        void price(const PathBlock& paths, Real* values);
+        ext::shared_ptr<path_generator_type> pathGenerator_;
+        ext::shared_ptr<BatchPathPricer> pathPricer_;
+        bool antitheticVariate_;
+        ext::shared_ptr<BatchPathPricer> cvPathPricer_;
+        Real cvOptionValue_;
+        std::vector<Real> values_, antitheticValues_, cvValues_;
+        S sampleAccumulator_;
+        StreamingStatistics groups_;
+        McProfile profile_;
+    };
+
+    namespace detail {
+
+        template <class M, class = void>
+        struct has_group_statistics : std::false_type {};
+
+        template <class M>
+        struct has_group_statistics<
+            M, decltype(void(std::declval<const M&>().groupStatistics()))>
+        : std::true_type {};
+
+    }
+
+    //! group averages of a model, or empty statistics if it has none
+    template <class Model>
+    inline StreamingStatistics groupStatisticsOf(const Model& model) {
+        if constexpr (detail::has_group_statistics<Model>::value)
+            return model.groupStatistics();
+        else
+            return StreamingStatistics();
+    }
+
+
+    // template definitions
+
+    template <class GSG>
+    inline ConstantBSBatchPathGenerator<GSG>::ConstantBSBatchPathGenerator(
+                                const ConstantBlackScholesProcess& process,
+                                const TimeGrid& timeGrid,
+                                GSG generator,
+                                bool brownianBridge,
+                                Size batchSize,
+                                BatchSampling sampling,
+                                bool singlePrecision)
+    : generator_(std::move(generator)), brownianBridge_(brownianBridge),
+      bb_(timeGrid), sampling_(sampling), singlePrecision_(singlePrecision),
+      x0_(process.x0()), logX0_(std::log(process.x0())),
+      drift_(timeGrid.size() - 1), stdDev_(timeGrid.size() - 1),
+      dw_((timeGrid.size() - 1) * batchSize), temp_(timeGrid.size() - 1),
+      z_(timeGrid.size() - 1),
+      dwf_(singlePrecision ? (timeGrid.size() - 1) * batchSize : 0),
+      logReturns_(singlePrecision ? timeGrid.size() * batchSize : 0),
+      compensation_(singlePrecision ? batchSize : 0),
+      block_(timeGrid, batchSize) {
+        QL_REQUIRE(batchSize > 0, "null batch size");
+        checkBatchSampling(sampling_, batchSize);
+        QL_REQUIRE(generator_.dimension() == timeGrid.size() - 1,
+                   "sequence generator dimensionality ("
+                   << generator_.dimension() << ") != timeSteps ("
+                   << timeGrid.size() - 1 << ")");
+        for (Size i = 0; i < drift_.size(); ++i) {
+            Time dt = timeGrid.dt(i);
+            drift_[i] = process.logDrift() * dt;
+            stdDev_[i] = process.stdDeviation(timeGrid[i], x0_, dt);
+        }
+    }
+
+    template <class GSG>
+    inline const PathBlock&
+    ConstantBSBatchPathGenerator<GSG>::next(Size paths) const {
+        QL_REQUIRE(paths % groupSize() == 0,
+                   "paths (" << paths << ") must come in whole groups of "
+                   << groupSize());
+        block_.resize(paths);
+        QL_MC_PROFILE_ONLY(profile_.paths += paths);
+        QL_MC_PROFILE_ONLY(profile_.randomDraws += paths * drift_.size());
+        draw();
+        build(1.0);
+        return block_;
+    }
+
+    template <class GSG>
+    inline void ConstantBSBatchPathGenerator<GSG>::draw() const {
+        QL_MC_PROFILE_PHASE(profile_, RandomNumbers);
+        Size paths = block_.size();
+        Size steps = drift_.size(), capacity = block_.capacity();
+        Real* weights = block_.weights();
+        for (Size p = 0; p < paths; ++p) {
+            const typename GSG::sample_type& sequence =
+                generator_.nextSequence();
+            weights[p] = sequence.weight;
+            if (sampling_.strata > 1) {
+                // the first normal of the bridge gives the terminal value:
+                // it is mapped into the (p mod k)-th stratum
+                std::copy(sequence.value.begin(), sequence.value.end(),
+                          z_.begin());
+                Real u = ((p % sampling_.strata) + phi_(z_[0])) / sampling_.strata;
+                z_[0] = inversePhi_(std::min(std::max(u, QL_EPSILON),
+                                             1.0 - QL_EPSILON));
+                bb_.transform(z_.begin(), z_.end(), temp_.begin());
+                for (Size i = 0; i < steps; ++i)
+                    dw_[i * capacity + p] = temp_[i];
+            } else if (brownianBridge_) {
+                bb_.transform(sequence.value.begin(), sequence.value.end(),
+                              temp_.begin());
+                for (Size i = 0; i < steps; ++i)
+                    dw_[i * capacity + p] = temp_[i];
+            } else {
+                for (Size i = 0; i < steps; ++i)
+                    dw_[i * capacity + p] = sequence.value[i];
+            }
+        }
+        if (sampling_.momentMatching)
+            matchMoments();
+        if (singlePrecision_) {
+            for (Size i = 0; i < steps; ++i)
+                std::copy(&dw_[i * capacity], &dw_[i * capacity] + paths,
+                          &dwf_[i * capacity]);
+        }
+    }
+
+    template <class GSG>
+    inline void ConstantBSBatchPathGenerator<GSG>::matchMoments() const {
+        Size paths = block_.size(), capacity = block_.capacity();
+        for (Size i = 0; i < drift_.size(); ++i) {
+            Real* w = &dw_[i * capacity];
+            Real mean = 0.0, variance = 0.0;
+            for (Size p = 0; p < paths; ++p)
+                mean += w[p];
+            mean /= paths;
+            for (Size p = 0; p < paths; ++p)
+                variance += (w[p] - mean) * (w[p] - mean);
+            variance /= paths;
+            Real scale = variance > 0.0 ? 1.0 / std::sqrt(variance) : 1.0;
+            for (Size p = 0; p < paths; ++p)
+                w[p] = (w[p] - mean) * scale;
+        }
+    }
+
+    template <class GSG>
+    inline const PathBlock&
+    ConstantBSBatchPathGenerator<GSG>::antithetic() const {
+        QL_MC_PROFILE_ONLY(profile_.paths += block_.size());
+        build(-1.0);
+        return block_;
+    }
+
+    template <class GSG>
+    inline void ConstantBSBatchPathGenerator<GSG>::build(Real sign) const {
+        if (singlePrecision_) {
+            buildSingle(sign);
+            return;
+        }
+        QL_MC_PROFILE_PHASE(profile_, PathConstruction);
+        Size paths = block_.size(), capacity = block_.capacity();
+        // log-spot, node by node; the inner loops are contiguous
+        Real* previous = block_.node(0);
+        std::fill(previous, previous + paths, logX0_);
+        for (Size i = 0; i < drift_.size(); ++i) {
+            Real* current = block_.node(i + 1);
+            const Real* w = &dw_[i * capacity];
+            const Real drift = drift_[i], stdDev = sign * stdDev_[i];
+            for (Size p = 0; p < paths; ++p)
+                current[p] = previous[p] + drift + stdDev * w[p];
+            previous = current;
+        }
+        for (Size i = 1; i < block_.length(); ++i)
+            vectorExp(block_.node(i), paths);
+        Real* first = block_.node(0);
+        std::fill(first, first + paths, x0_);
+    }
+
+    template <class GSG>
+    inline void ConstantBSBatchPathGenerator<GSG>::buildSingle(Real sign) const {
+        QL_MC_PROFILE_PHASE(profile_, PathConstruction);
+        Size paths = block_.size(), capacity = block_.capacity();
+        // log-returns from x0, with a Kahan compensation per path
+        float* previous = &logReturns_[0];
+        float* c = &compensation_[0];
+        std::fill(previous, previous + paths, 0.0f);
+        std::fill(c, c + paths, 0.0f);
+        for (Size i = 0; i < drift_.size(); ++i) {
+            float* current = &logReturns_[(i + 1) * capacity];
+            const float* w = &dwf_[i * capacity];
+            const float drift = float(drift_[i]);
+            const float stdDev = float(sign * stdDev_[i]);
+            for (Size p = 0; p < paths; ++p) {
+                float y = drift + stdDev * w[p] - c[p];
+                float t = previous[p] + y;
+                c[p] = (t - previous[p]) - y;
+                current[p] = t;
+            }
+            previous = current;
+        }
+        for (Size i = 1; i < block_.length(); ++i) {
+            float* x = &logReturns_[i * capacity];
+            vectorExp(x, paths);
+            Real* spots = block_.node(i);
+            for (Size p = 0; p < paths; ++p)
+                spots[p] = x0_ * x[p];
+        }
+        Real* first = block_.node(0);
+        std::fill(first, first + paths, x0_);
+    }
+
+    template <class RNG, class S>
+    inline void BatchMonteCarloModel<RNG,S>::price(const PathBlock& paths,
+                                                   Real* values) {
+        QL_MC_PROFILE_PHASE(profile_, Pricing);
+        (*pathPricer_)(paths, values);
+        if (cvPathPricer_) {
+            (*cvPathPricer_)(paths, &cvValues_[0]);
+            for (Size p = 0; p < paths.size(); ++p)
+                values[p] += cvOptionValue_ - cvValues_[p];
+        }
+    }
+
+    template <class RNG, class S>
+    inline void BatchMonteCarloModel<RNG,S>::addSamples(Size samples) {
+        // whole groups only (a group never spans two blocks)
+        Size group = pathGenerator_->groupSize();
+        samples = (samples + group - 1) / group * group;
+        while (samples > 0) {
+            Size n = std::min(samples, pathGenerator_->batchSize());
+            const PathBlock& paths = pathGenerator_->next(n);
+            price(paths, &values_[0]);
+            if (antitheticVariate_) {
+                // the antithetic block overwrites the same storage
+                pathGenerator_->antithetic();
+                price(paths, &antitheticValues_[0]);
+                for (Size p = 0; p < n; ++p)
+                    values_[p] = (values_[p] + antitheticValues_[p]) / 2.0;
+            }
+
+            QL_MC_PROFILE_PHASE(profile_, Accumulation);
+            const Real* weights = paths.weights();
+            for (Size p = 0; p < n; ++p)
+                sampleAccumulator_.add(values_[p], weights[p]);
+            for (Size first = 0; group > 1 && first < n; first += group) {
+                Real sum = 0.0, weightSum = 0.0;
+                for (Size p = first; p < first + group; ++p) {
+                    sum += weights[p] * values_[p];
+                    weightSum += weights[p];
+                }
+                groups_.add(sum / weightSum, weightSum / group);
+            }
+            samples -= n;
+        }
+    }
+
+} // namespace QuantLib
+
+#endif
@@ -0,0 +1,297 @@
+// Benchmark : moteurs QuantLib d'origine, moteurs _2 non constants et
+// constants, sur une grille de pas de temps et de nombres de tirages.
+//
+//   ./bench/bench [fichier.csv] [répétitions]
+//
+// Chaque configuration est répétée ; on garde la médiane et le 95e
+// centile des temps. Les huit premières colonnes du CSV suivent le
+// schéma de main.cpp (c_ = process constant, sans préfixe = non
+// constant, temps médians) ; les suivantes ajoutent le moteur d'origine,
+// le 95e centile, le débit (tirages par seconde) et la simulation par
+// blocs en double (b_) et en float (f32_), avec l'écart de NPV entre les
+// deux (mêmes tirages, seule la précision des chemins change).
+#include <ql/qldefines.hpp>
+#ifdef BOOST_MSVC
+#  include <ql/auto_link.hpp>
+#endif
+
+#include "../mceuropeanengine.hpp"
+#include "../mc_discr_arith_av_strike.hpp"
+#include "../mcbarrierengine.hpp"
+
+#include <ql/pricingengines/vanilla/mceuropeanengine.hpp>
+#include <ql/pricingengines/asian/mc_discr_arith_av_strike.hpp>
+#include <ql/pricingengines/barrier/mcbarrierengine.hpp>
+
+#include <ql/instruments/europeanoption.hpp>
+#include <ql/instruments/asianoption.hpp>
+#include <ql/instruments/barrieroption.hpp>
+#include <ql/instruments/payoffs.hpp>
+#include <ql/exercise.hpp>
+
+#include <ql/termstructures/yield/zerocurve.hpp>
+#include <ql/termstructures/volatility/equityfx/blackvariancecurve.hpp>
+#include <ql/time/calendars/target.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace QuantLib;
+
+namespace {
+
+    // valeur, erreur et temps (médiane, 95e centile) d'un moteur
+    struct Timing {
+        Real npv = 0.0, error = 0.0;
+        double median = 0.0, p95 = 0.0;
+    };
+
+    // prix de l'instrument avec le moteur donné, `runs` fois
+    Timing benchmark(Instrument& instrument,
+                     const ext::shared_ptr<PricingEngine>& engine,
+                     Size runs) {
+        instrument.setPricingEngine(engine);
+        std::vector<double> seconds;
+        seconds.reserve(runs);
+        Timing t;
+        for (Size r = 0; r < runs; ++r) {
+            auto start = std::chrono::steady_clock::now();
+            instrument.recalculate();
+            auto end = std::chrono::steady_clock::now();
+            seconds.push_back(std::chrono::duration<double>(end - start).count());
+        }
+        t.npv = instrument.NPV();
+        t.error = instrument.errorEstimate();
+
+        // centiles au rang le plus proche
+        std::sort(seconds.begin(), seconds.end());
+        t.median = seconds[(runs - 1) / 2];
+        t.p95 = seconds[std::min<Size>(runs - 1,
+            Size(std::ceil(0.95 * runs)) - 1)];
+        return t;
+    }
+
+    double rate(Size samples, const Timing& t) {
+        return t.median > 0.0 ? samples / t.median : 0.0;
+    }
+
+    void writeRow(std::ostream& out,
+                  const std::string& kind, Size steps, Size samples, Size runs,
+                  const Timing& constant, const Timing& nonConstant,
+                  const Timing& old,
+                  const Timing& batch, const Timing& single) {
+        out << steps << ',' << samples << ','
+            << constant.error << ',' << constant.npv << ',' << constant.median << ','
+            << nonConstant.error << ',' << nonConstant.npv << ',' << nonConstant.median << ','
+            << kind << ',' << runs << ','
+            << constant.p95 << ',' << nonConstant.p95 << ','
+            << rate(samples, constant) << ',' << rate(samples, nonConstant) << ','
+            << old.error << ',' << old.npv << ',' << old.median << ','
+            << old.p95 << ',' << rate(samples, old) << ','
+            << batch.npv << ',' << batch.median << ','
+            << single.npv << ',' << single.median << ','
+            << single.npv - batch.npv << '\n';
+    }
+
+    void printRow(const std::string& kind, Size steps, Size samples,
+                  const Timing& constant, const Timing& nonConstant,
+                  const Timing& old,
+                  const Timing& batch, const Timing& single) {
+        Size width = 13;
+        auto spacer = std::setw(width);
+        std::cout << spacer << kind << spacer << steps << spacer << samples
+                  << spacer << old.npv << spacer << old.median
+                  << spacer << nonConstant.npv << spacer << nonConstant.median
+                  << spacer << constant.npv << spacer << constant.median
+                  << spacer << old.median / constant.median
+                  << spacer << batch.median / single.median
+                  << spacer << single.npv - batch.npv
+                  << std::endl;
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+
+    try {
+        std::string fileName = (argc > 1) ? argv[1] : "bench.csv";
+        Size runs = (argc > 2) ? Size(std::atoi(argv[2])) : 5;
+        QL_REQUIRE(runs > 0, "at least one run required");
+
+        const std::vector<Size> stepGrid   = { 10, 50, 250 };
+        const std::vector<Size> sampleGrid = { 10000, 100000, 1000000 };
+        const BigNatural mcSeed = 42;
+        const Size batchSize = 1024;
+
+        // même marché et mêmes options que main.cpp
+        Date today(24, February, 2022);
+        Settings::instance().evaluationDate() = today;
+
+        Handle<Quote> underlyingH(ext::make_shared<SimpleQuote>(36.0));
+        DayCounter dayCounter = Actual365Fixed();
+        Handle<YieldTermStructure> riskFreeRate(
+            ext::make_shared<ZeroCurve>(
+                std::vector<Date>{today, today + 6*Months},
+                std::vector<Rate>{0.01, 0.015},
+                dayCounter
+            )
+        );
+        Handle<BlackVolTermStructure> volatility(
+            ext::make_shared<BlackVarianceCurve>(
+                today,
+                std::vector<Date>{today + 3*Months, today + 6*Months},
+                std::vector<Volatility>{0.20, 0.25},
+                dayCounter
+            )
+        );
+        auto bsmProcess = ext::make_shared<BlackScholesProcess>(
+            underlyingH, riskFreeRate, volatility
+        );
+
+        Real strike = 40;
+        Date maturity(24, May, 2022);
+        auto exercise = ext::make_shared<EuropeanExercise>(maturity);
+        auto payoff   = ext::make_shared<PlainVanillaPayoff>(Option::Put, strike);
+
+        EuropeanOption europeanOption(payoff, exercise);
+        std::vector<Date> fixings = {
+            Date(4,  March, 2022), Date(14, March, 2022), Date(24, March, 2022),
+            Date(4,  April, 2022), Date(14, April, 2022), Date(24, April, 2022),
+            Date(4,  May, 2022),   Date(14, May, 2022),   Date(24, May, 2022)
+        };
+        DiscreteAveragingAsianOption asianOption(
+            Average::Arithmetic, fixings, payoff, exercise);
+        BarrierOption barrierOption(Barrier::UpIn, 40, 0, payoff, exercise);
+
+        std::ofstream file(fileName, std::ios::out | std::ios::trunc);
+        QL_REQUIRE(file, "cannot open " << fileName);
+        file << "step,sample,c_err,c_npv,c_time,err,npv,time,"
+             << "kind,runs,c_time_p95,time_p95,c_rate,rate,"
+             << "old_err,old_npv,old_time,old_time_p95,old_rate,"
+             << "b_npv,b_time,f32_npv,f32_time,f32_diff\n";
+        file << std::setprecision(10);
+
+        Size width = 13;
+        auto spacer = std::setw(width);
+        std::cout << spacer << "kind" << spacer << "steps" << spacer << "samples"
+                  << spacer << "old NPV" << spacer << "old [s]"
+                  << spacer << "NPV" << spacer << "time [s]"
+                  << spacer << "c NPV" << spacer << "c time [s]"
+                  << spacer << "speedup" << spacer << "f32 speedup"
+                  << spacer << "f32 - f64" << std::endl;
+        std::cout << std::string(12 * width, '-') << std::endl;
+
+        for (Size samples : sampleGrid) {
+            for (Size steps : stepGrid) {
+                // European
+                Timing old = benchmark(europeanOption,
+                    MakeMCEuropeanEngine<PseudoRandom>(bsmProcess)
+                    .withSteps(steps).withSamples(samples).withSeed(mcSeed),
+                    runs);
+                Timing nonConstant = benchmark(europeanOption,
+                    MakeMCEuropeanEngine_2<PseudoRandom, Statistics>(bsmProcess)
+                    .withSteps(steps).withSamples(samples).withSeed(mcSeed)
+                    .withConstantParameters(false),
+                    runs);
+                Timing constant = benchmark(europeanOption,
+                    MakeMCEuropeanEngine_2<PseudoRandom, Statistics>(bsmProcess)
+                    .withSteps(steps).withSamples(samples).withSeed(mcSeed)
+                    .withConstantParameters(true),
+                    runs);
+                Timing batch = benchmark(europeanOption,
+                    MakeMCEuropeanEngine_2<PseudoRandom, Statistics>(bsmProcess)
+                    .withSteps(steps).withSamples(samples).withSeed(mcSeed)
+                    .withConstantParameters(true).withBatchSize(batchSize),
+                    runs);
+                Timing single = benchmark(europeanOption,
+                    MakeMCEuropeanEngine_2<PseudoRandom, Statistics>(bsmProcess)
+                    .withSteps(steps).withSamples(samples).withSeed(mcSeed)
+                    .withConstantParameters(true).withBatchSize(batchSize)
+                    .withSinglePrecision(),
+                    runs);
+                writeRow(file, "European", steps, samples, runs,
+                         constant, nonConstant, old, batch, single);
+                printRow("European", steps, samples,
+                         constant, nonConstant, old, batch, single);
+
+                // Barrier
+                old = benchmark(barrierOption,
+                    MakeMCBarrierEngine<PseudoRandom>(bsmProcess)
+                    .withSteps(steps).withSamples(samples).withSeed(mcSeed),
+                    runs);
+                nonConstant = benchmark(barrierOption,
+                    MakeMCBarrierEngine_2<PseudoRandom, Statistics>(bsmProcess)
+                    .withSteps(steps).withSamples(samples).withSeed(mcSeed)
+                    .withConstantParameters(false),
+                    runs);
+                constant = benchmark(barrierOption,
+                    MakeMCBarrierEngine_2<PseudoRandom, Statistics>(bsmProcess)
+                    .withSteps(steps).withSamples(samples).withSeed(mcSeed)
+                    .withConstantParameters(true),
+                    runs);
+                batch = benchmark(barrierOption,
+                    MakeMCBarrierEngine_2<PseudoRandom, Statistics>(bsmProcess)
+                    .withSteps(steps).withSamples(samples).withSeed(mcSeed)
+                    .withConstantParameters(true).withBatchSize(batchSize),
+                    runs);
+                single = benchmark(barrierOption,
+                    MakeMCBarrierEngine_2<PseudoRandom, Statistics>(bsmProcess)
+                    .withSteps(steps).withSamples(samples).withSeed(mcSeed)
+                    .withConstantParameters(true).withBatchSize(batchSize)
+                    .withSinglePrecision(),
+                    runs);
+                writeRow(file, "Barrier", steps, samples, runs,
+                         constant, nonConstant, old, batch, single);
+                printRow("Barrier", steps, samples,
+                         constant, nonConstant, old, batch, single);
+            }
+
+            // Asian : la grille est celle des fixings, pas de balayage
+            Timing old = benchmark(asianOption,
+                MakeMCDiscreteArithmeticASEngine<PseudoRandom>(bsmProcess)
+                .withSamples(samples).withSeed(mcSeed),
+                runs);
+            Timing nonConstant = benchmark(asianOption,
+                MakeMCDiscreteArithmeticASEngine_2<PseudoRandom, Statistics>(bsmProcess)
+                .withSamples(samples).withSeed(mcSeed)
+                .withConstantParameters(false),
+                runs);
+            Timing constant = benchmark(asianOption,
+                MakeMCDiscreteArithmeticASEngine_2<PseudoRandom, Statistics>(bsmProcess)
+                .withSamples(samples).withSeed(mcSeed)
+                .withConstantParameters(true),
+                runs);
+            Timing batch = benchmark(asianOption,
+                MakeMCDiscreteArithmeticASEngine_2<PseudoRandom, Statistics>(bsmProcess)
+                .withSamples(samples).withSeed(mcSeed)
+                .withConstantParameters(true).withBatchSize(batchSize),
+                runs);
+            Timing single = benchmark(asianOption,
+                MakeMCDiscreteArithmeticASEngine_2<PseudoRandom, Statistics>(bsmProcess)
+                .withSamples(samples).withSeed(mcSeed)
+                .withConstantParameters(true).withBatchSize(batchSize)
+                .withSinglePrecision(),
+                runs);
+            writeRow(file, "Asian", fixings.size(), samples, runs,
+                     constant, nonConstant, old, batch, single);
+            printRow("Asian", fixings.size(), samples,
+                     constant, nonConstant, old, batch, single);
+        }
+
+        std::cout << std::endl << "results written to " << fileName << std::endl;
+        return 0;
+
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    } catch (...) {
+        std::cerr << "unknown error" << std::endl;
+        return 1;
+    }
+}
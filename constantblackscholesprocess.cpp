@@ -2,38 +2,47 @@
 #ifdef BOOST_MSVC
 #  include <ql/auto_link.hpp>
 #endif
-#include <iostream>
+#include <cmath>
 #include "constantblackscholesprocess.hpp"
-#include <ql/processes/eulerdiscretization.hpp>
 namespace QuantLib {
-    
-    /* ConstantBlackScholesProcess::ConstantBlackScholesProcess(double x0, double dividendYield, double riskFreeRate, double volatility)
-    : StochasticProcess1D(ext::make_shared<QuantLib::EulerDiscretization>()),
-      x0_(x0), dividendYield_(dividendYield), riskFreeRate_(riskFreeRate), volatility_(volatility) {}
-   
- */
-   ConstantBlackScholesProcess::ConstantBlackScholesProcess(double x0, double dividendYield,double riskFreeRate, double volatility)
-        :StochasticProcess1D(ext::make_shared<EulerDiscretization>()){
-        x0_ = x0;  
-        dividendYield_ = dividendYield;
-        riskFreeRate_ = riskFreeRate;
-        volatility_ = volatility;
-        }
+
+    // No discretization object: evolve(), expectation() and stdDeviation()
+    // are exact for constant parameters and are overridden below.
+    ConstantBlackScholesProcess::ConstantBlackScholesProcess(double x0, double dividendYield,double riskFreeRate, double volatility)
+        : x0_(x0), dividendYield_(dividendYield),
+          riskFreeRate_(riskFreeRate), volatility_(volatility),
+          logDrift_(riskFreeRate - dividendYield - 0.5 * volatility * volatility) {}
 
     Real ConstantBlackScholesProcess::x0() const {
-        return x0_;  
+        return x0_;
     }
 
-    Real ConstantBlackScholesProcess::drift(Time t, Real x) const {
-        return (riskFreeRate_ - dividendYield_ - 0.5 * volatility_ * volatility_ ) ;
+    Real ConstantBlackScholesProcess::drift(Time, Real) const {
+        return logDrift_;
     }
 
-    Real ConstantBlackScholesProcess::diffusion(Time t, Real x) const {
+    Real ConstantBlackScholesProcess::diffusion(Time, Real) const {
         return volatility_ ;
     }
 
     Real ConstantBlackScholesProcess::apply(Real x0, Real dx) const {
-        return x0 * std::exp(dx); 
+        return x0 * std::exp(dx);
+    }
+
+    Real ConstantBlackScholesProcess::expectation(Time, Real x0, Time dt) const {
+        return x0 * std::exp((riskFreeRate_ - dividendYield_) * dt);
+    }
+
+    Real ConstantBlackScholesProcess::stdDeviation(Time, Real, Time dt) const {
+        return volatility_ * std::sqrt(dt);
+    }
+
+    Real ConstantBlackScholesProcess::variance(Time, Real, Time dt) const {
+        return volatility_ * volatility_ * dt;
+    }
+
+    Real ConstantBlackScholesProcess::evolve(Time, Real x0, Time dt, Real dw) const {
+        return x0 * std::exp(logDrift_ * dt + volatility_ * std::sqrt(dt) * dw);
     }
 
-}
\ No newline at end of file
+}
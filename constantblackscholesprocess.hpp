@@ -5,20 +5,40 @@
 
 namespace QuantLib {
 
+    /*! Black-Scholes process with constant spot, rates and volatility.
+
+        Since all parameters are constant, the log-spot increments are
+        exactly Gaussian; evolve(), expectation() and stdDeviation() are
+        therefore given in closed form instead of going through a
+        discretization object, and the drift term (r-q-sigma^2/2) is
+        computed once at construction.
+    */
     class ConstantBlackScholesProcess : public StochasticProcess1D {
         public:
             ConstantBlackScholesProcess(double x0, double dividendYield,double riskFreeRate, double volatility);
             Real x0() const;
             Real drift(Time t, Real x) const;
-            //Real evolve(Time t0, Real x0, Time dt, Real dw) const;
-            Real apply(Real x0, Real dx) const ;
             Real diffusion(Time t, Real x) const;
-        private:
-            double x0_;  
-            double dividendYield_; 
-            double riskFreeRate_; 
-            double volatility_;         
+            Real apply(Real x0, Real dx) const ;
+            //! exact conditional expectation x0*exp((r-q)dt)
+            Real expectation(Time t0, Real x0, Time dt) const;
+            //! standard deviation of the log-spot increment, sigma*sqrt(dt)
+            Real stdDeviation(Time t0, Real x0, Time dt) const;
+            Real variance(Time t0, Real x0, Time dt) const;
+            //! exact log-normal step x0*exp((r-q-sigma^2/2)dt + sigma*sqrt(dt)*dw)
+            Real evolve(Time t0, Real x0, Time dt, Real dw) const;
 
+            Real dividendYield() const { return dividendYield_; }
+            Real riskFreeRate() const { return riskFreeRate_; }
+            Real volatility() const { return volatility_; }
+            //! log-space drift r-q-sigma^2/2
+            Real logDrift() const { return logDrift_; }
+        private:
+            double x0_;
+            double dividendYield_;
+            double riskFreeRate_;
+            double volatility_;
+            double logDrift_;
     };
 };
 #endif // CONSTANT_BLACK_SCHOLES_PROCESS_HPP
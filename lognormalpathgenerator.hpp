@@ -0,0 +1,162 @@
+#ifndef QL_LOGNORMALPATHGENERATOR_HPP
+#define QL_LOGNORMALPATHGENERATOR_HPP
+
+#include <ql/methods/montecarlo/brownianbridge.hpp>
+#include <ql/methods/montecarlo/path.hpp>
+#include <ql/methods/montecarlo/sample.hpp>
+#include <ql/timegrid.hpp>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "constantblackscholesprocess.hpp"
+#include "piecewiseconstantblackscholesprocess.hpp"
+#include "simdkernels.hpp"
+
+namespace QuantLib {
+
+    //! Log-normal steps of a process, resolved at compile time
+    /*! drift() and stdDev() give the log-spot drift and standard
+        deviation of the i-th step of the grid.  Only defined for the
+        processes whose steps are exactly log-normal.
+    */
+    template <class Process>
+    struct LogNormalStepTraits;
+
+    template <>
+    struct LogNormalStepTraits<ConstantBlackScholesProcess> {
+        static Real drift(const ConstantBlackScholesProcess& process,
+                          const TimeGrid& grid, Size i) {
+            return process.logDrift() * grid.dt(i);
+        }
+        static Real stdDev(const ConstantBlackScholesProcess& process,
+                           const TimeGrid& grid, Size i) {
+            return process.volatility() * std::sqrt(grid.dt(i));
+        }
+    };
+
+    //! the process must have been built on the grid of the paths
+    template <>
+    struct LogNormalStepTraits<PiecewiseConstantBlackScholesProcess> {
+        static Real drift(const PiecewiseConstantBlackScholesProcess& process,
+                          const TimeGrid& grid, Size i) {
+            return process.logDrift(i) * grid.dt(i);
+        }
+        static Real stdDev(const PiecewiseConstantBlackScholesProcess& process,
+                           const TimeGrid& grid, Size i) {
+            return process.volatility(i) * std::sqrt(grid.dt(i));
+        }
+    };
+
+    //! path of the log-normal steps (drift, stdDev) driven by sign*w
+    /*! The log-spot at the nodes is a running sum of the increments; the
+        exponential is then taken over the whole path with vectorExp().
+    */
+    inline void buildLogNormalPath(Real x0,
+                                   const std::vector<Real>& drift,
+                                   const std::vector<Real>& stdDev,
+                                   const std::vector<Real>& w,
+                                   Real sign,
+                                   Path& path) {
+        Size steps = drift.size();
+        Real* x = &path[0];
+        Real logX = std::log(x0);
+        for (Size i = 0; i < steps; ++i) {
+            logX += drift[i] + sign * stdDev[i] * w[i];
+            x[i + 1] = logX;
+        }
+        vectorExp(x + 1, steps);
+        x[0] = x0;
+    }
+
+    //! Path generator for a log-normal process known at compile time
+    /*! Same samples as PathGenerator on the same process (normals drawn
+        from GSG, optionally through a Brownian bridge), but the drift
+        and standard deviation of each step are read once from the
+        process at construction: a path is then a running sum of the
+        log-spot increments followed by one vectorExp() over the nodes,
+        with no virtual call to the process.  The path values may differ
+        from PathGenerator's in the last bits.
+
+        Holds no reference to the process, so a copy of the process per
+        thread is not needed; the generator itself is not thread-safe.
+    */
+    template <class GSG, class Process>
+    class LogNormalPathGenerator {
+      public:
+        typedef Sample<Path> sample_type;
+        typedef LogNormalStepTraits<Process> traits;
+
+        LogNormalPathGenerator(const Process& process,
+                               const TimeGrid& timeGrid,
+                               GSG generator,
+                               bool brownianBridge);
+        const sample_type& next() const;
+        const sample_type& antithetic() const;
+        Size size() const { return drift_.size(); }
+        const TimeGrid& timeGrid() const { return next_.value.timeGrid(); }
+      private:
+        const sample_type& build(Real sign) const;
+        GSG generator_;
+        bool brownianBridge_;
+        BrownianBridge bb_;
+        Real x0_;
+        std::vector<Real> drift_, stdDev_;
+        mutable sample_type next_;
+        mutable std::vector<Real> temp_;
+    };
+
+
+    // template definitions
+
+    template <class GSG, class Process>
+    inline LogNormalPathGenerator<GSG,Process>::LogNormalPathGenerator(
+                                                  const Process& process,
+                                                  const TimeGrid& timeGrid,
+                                                  GSG generator,
+                                                  bool brownianBridge)
+    : generator_(std::move(generator)), brownianBridge_(brownianBridge),
+      bb_(timeGrid), x0_(process.x0()),
+      drift_(timeGrid.size() - 1), stdDev_(timeGrid.size() - 1),
+      next_(Path(timeGrid), 1.0), temp_(timeGrid.size() - 1) {
+        QL_REQUIRE(generator_.dimension() == timeGrid.size() - 1,
+                   "sequence generator dimensionality ("
+                   << generator_.dimension() << ") != timeSteps ("
+                   << timeGrid.size() - 1 << ")");
+        for (Size i = 0; i < drift_.size(); ++i) {
+            drift_[i] = traits::drift(process, timeGrid, i);
+            stdDev_[i] = traits::stdDev(process, timeGrid, i);
+        }
+    }
+
+    template <class GSG, class Process>
+    inline const typename LogNormalPathGenerator<GSG,Process>::sample_type&
+    LogNormalPathGenerator<GSG,Process>::next() const {
+        const typename GSG::sample_type& sequence = generator_.nextSequence();
+        if (brownianBridge_)
+            bb_.transform(sequence.value.begin(), sequence.value.end(),
+                          temp_.begin());
+        else
+            std::copy(sequence.value.begin(), sequence.value.end(),
+                      temp_.begin());
+        next_.weight = sequence.weight;
+        return build(1.0);
+    }
+
+    template <class GSG, class Process>
+    inline const typename LogNormalPathGenerator<GSG,Process>::sample_type&
+    LogNormalPathGenerator<GSG,Process>::antithetic() const {
+        return build(-1.0);
+    }
+
+    template <class GSG, class Process>
+    inline const typename LogNormalPathGenerator<GSG,Process>::sample_type&
+    LogNormalPathGenerator<GSG,Process>::build(Real sign) const {
+        buildLogNormalPath(x0_, drift_, stdDev_, temp_, sign, next_.value);
+        return next_;
+    }
+
+} // namespace QuantLib
+
+#endif
@@ -2,30 +2,133 @@
 #define mc_discrete_arithmetic_average_strike_asian_engine_hpp
 
 #include <ql/exercise.hpp>
+#include <ql/math/distributions/normaldistribution.hpp>
 #include <ql/pricingengines/asian/mcdiscreteasianenginebase.hpp>
 #include <ql/pricingengines/asian/mc_discr_arith_av_strike.hpp>
 #include <ql/processes/blackscholesprocess.hpp>
+#include <ql/termstructures/volatility/equityfx/blackconstantvol.hpp>
+#include <ql/termstructures/volatility/equityfx/blackvariancecurve.hpp>
+#include <algorithm>
+#include <cmath>
 #include <utility>
+#include <vector>
 
 #include "myconstutil.hpp"                  // si vous factorisez la construction du process constant
 #include "constantblackscholesprocess.hpp"  // votre classe "ConstantBlackScholesProcess"
+#include "mcparallel.hpp"
+#include "batchpathgenerator.hpp"
+#include "mcrandomizedqmc.hpp"
+#include "philoxrng.hpp"
+#include "mcpathmodel.hpp"
+#include "lognormalpathgenerator.hpp"
+#include "mcgreeks.hpp"
+#include "mcscenarios.hpp"
+#include "mcconstantprocesshelper.hpp"
 
 namespace QuantLib {
 
+    //! Geometric average-strike path pricer
+    /*! Same fixing convention as ArithmeticASOPathPricer, with no past
+        fixings; used as control variate for the arithmetic engine.
+    */
+    class GeometricASOPathPricer : public PathPricer<Path> {
+      public:
+        GeometricASOPathPricer(Option::Type type, DiscountFactor discount)
+        : type_(type), discount_(discount) {}
+        Real operator()(const Path& path) const override {
+            Size n = path.length();
+            QL_REQUIRE(n > 1, "the path cannot be empty");
+            Size first = path.timeGrid().mandatoryTimes()[0] == 0.0 ? 0 : 1;
+            Real logSum = 0.0;
+            for (Size i = first; i < n; ++i)
+                logSum += std::log(path[i]);
+            Real averageStrike = std::exp(logSum / (n - first));
+            return discount_ * PlainVanillaPayoff(type_, averageStrike)(path.back());
+        }
+      private:
+        Option::Type type_;
+        DiscountFactor discount_;
+    };
+
+    /*! Undiscounted value of the geometric average-strike option when the
+        log-spot at the fixing nodes is Gaussian with means logMeans[i] and
+        Cov(ln S_i, ln S_j) = variances[min(i,j)], the last node being the
+        exercise one.  This holds for Black-Scholes dynamics with
+        deterministic rates and strike-independent volatility; the option
+        is then an exchange option between S_T and G (Margrabe).
+    */
+    inline Real geometricAverageStrikeValue(Option::Type type,
+                                            const std::vector<Real>& logMeans,
+                                            const std::vector<Real>& variances) {
+        Size n = logMeans.size();
+        QL_REQUIRE(n > 0 && variances.size() == n, "inconsistent fixing data");
+        // ln G = moyenne des ln S_i
+        Real meanG = 0.0, varianceG = 0.0, covariance = 0.0;
+        for (Size i = 0; i < n; ++i) {
+            meanG += logMeans[i];
+            // paires (i,j) avec min(i,j) = i : 2(n-1-i)+1
+            varianceG += variances[i] * (2.0 * (n - 1 - i) + 1.0);
+            covariance += variances[i];
+        }
+        meanG /= n;
+        varianceG /= Real(n) * n;
+        covariance /= n;
+
+        Real forwardS = std::exp(logMeans[n - 1] + 0.5 * variances[n - 1]);
+        Real forwardG = std::exp(meanG + 0.5 * varianceG);
+        Real v2 = variances[n - 1] + varianceG - 2.0 * covariance;
+        Real sign = (type == Option::Call) ? 1.0 : -1.0;
+        if (v2 <= QL_EPSILON)
+            return std::max(sign * (forwardS - forwardG), 0.0);
+
+        Real v = std::sqrt(v2);
+        Real d1 = std::log(forwardS / forwardG) / v + 0.5 * v, d2 = d1 - v;
+        CumulativeNormalDistribution N;
+        return sign * (forwardS * N(sign * d1) - forwardG * N(sign * d2));
+    }
+
+    //! Batch version of GeometricASOPathPricer
+    class GeometricASOBatchPathPricer : public BatchPathPricer {
+      public:
+        GeometricASOBatchPathPricer(Option::Type type, DiscountFactor discount)
+        : type_(type), discount_(discount) {}
+        void operator()(const PathBlock& paths, Real* values) const override {
+            Size n = paths.length(), size = paths.size();
+            QL_REQUIRE(n > 1, "the path cannot be empty");
+            Size first = paths.timeGrid().mandatoryTimes()[0] == 0.0 ? 0 : 1;
+            std::fill(values, values + size, 0.0);
+            for (Size i = first; i < n; ++i) {
+                const Real* node = paths.node(i);
+                for (Size p = 0; p < size; ++p)
+                    values[p] += std::log(node[p]);
+            }
+            const Real* last = paths.node(n - 1);
+            const Real sign = (type_ == Option::Call) ? 1.0 : -1.0;
+            for (Size p = 0; p < size; ++p)
+                values[p] = discount_ *
+                    std::max(sign * (last[p] - std::exp(values[p] / (n - first))), 0.0);
+        }
+      private:
+        Option::Type type_;
+        DiscountFactor discount_;
+    };
+
     //!  Monte Carlo engine for discrete arithmetic average-strike Asian
     /*!
-      Suppose qu’on veuille gérer un booléen `constantParameters` 
-      pour utiliser un process constant ou non.
+      Les options (McEngineOptions) choisissent entre process constant
+      ou non, threads, blocs, greeks, scénarios et MLMC.
       On dérive de MCDiscreteAveragingAsianEngineBase<SingleVariate,RNG,S>.
     */
     template <class RNG = PseudoRandom, class S = Statistics>
     class MCDiscreteArithmeticASEngine_2
-        : public MCDiscreteAveragingAsianEngineBase<SingleVariate,RNG,S> {
+        : public MCDiscreteAveragingAsianEngineBase<SingleVariate,RNG,S>,
+          public ConstantProcessEngineMixin<MCDiscreteArithmeticASEngine_2<RNG,S>, RNG> {
       public:
         typedef typename MCDiscreteAveragingAsianEngineBase<SingleVariate, RNG, S>::path_generator_type path_generator_type;
         typedef typename MCDiscreteAveragingAsianEngineBase<SingleVariate, RNG, S>::path_pricer_type    path_pricer_type;
         typedef typename MCDiscreteAveragingAsianEngineBase<SingleVariate, RNG, S>::stats_type          stats_type;
 
+        //! options remplies d'ordinaire par MakeMCDiscreteArithmeticASEngine_2
         MCDiscreteArithmeticASEngine_2(
              const ext::shared_ptr<GeneralizedBlackScholesProcess>& process,
              bool brownianBridge,
@@ -34,62 +137,187 @@ namespace QuantLib {
              Real requiredTolerance,
              Size maxSamples,
              BigNatural seed,
-             bool constantParameters);
+             McEngineOptions options = McEngineOptions());
+
+        void calculate() const override;
+
+        //! allocations sur le tas pendant l'échantillonnage du dernier calcul
+        /*! Nul à nombre d'échantillons fixé : les chemins sont tirés dans
+            les buffers des générateurs et les pricers n'allouent pas.
+            Compté seulement si QL_MC_COUNT_HEAP_ALLOCATIONS est défini
+            (voir mcallocationcounter.hpp).
+        */
+        Size sampleAllocations() const {
+            return samplingReport_.sampleAllocations;
+        }
+
+        //! tirages utilisés et durée de l'échantillonnage du dernier calcul
+        /*! Avec une tolérance, elapsedTime est le temps pour l'atteindre. */
+        const SamplingReport& samplingReport() const {
+            return samplingReport_;
+        }
 
       private:
-        bool constantParameters;
+        typedef ConstantProcessEngineMixin<MCDiscreteArithmeticASEngine_2, RNG> process_mixin;
+        friend class ConstantProcessEngineMixin<MCDiscreteArithmeticASEngine_2, RNG>;
+        using process_mixin::constantProcess;
+        using process_mixin::piecewiseProcess;
+        using process_mixin::makePathGenerator;
+        using process_mixin::makeBatchPathGenerator;
+        using process_mixin::simulate;
+        using process_mixin::simulatePaths;
+        using process_mixin::simulateLogNormalPaths;
+        using process_mixin::simulateWithGreeks;
+        using process_mixin::simulateScenarios;
+        using process_mixin::addGreekAndScenarioResults;
+        using process_mixin::constantProcessCache_;
+        using process_mixin::options_;
+
+        mutable SamplingReport samplingReport_;
+        // grille des fixings et actualisation à l'échéance du calcul en
+        // cours (setupTimeGrid()), partagées par générateurs et pricers
+        mutable TimeGrid grid_;
+        mutable DiscountFactor discount_ = 0.0;
+
+        // une fois par calculate() : la grille de la classe de base
+        // convertit chaque date de fixing en temps
+        void setupTimeGrid() const {
+            auto exercise = ext::dynamic_pointer_cast<EuropeanExercise>(this->arguments_.exercise);
+            QL_REQUIRE(exercise, "wrong exercise given");
+            auto process = ext::dynamic_pointer_cast<GeneralizedBlackScholesProcess>(this->process_);
+            QL_REQUIRE(process, "Black-Scholes process required");
+            grid_ = MCDiscreteAveragingAsianEngineBase<SingleVariate,RNG,S>::timeGrid();
+            discount_ = process->riskFreeRate()->discount(exercise->lastDate());
+        }
 
         // Surcharge du pathGenerator()
         ext::shared_ptr<path_generator_type> pathGenerator() const override {
-            // On récupère la grille
-            Size dimensions = this->process_->factors();
-            TimeGrid grid   = this->timeGrid();
-
-            // Générateur pseudo-aléatoire
-            typename RNG::rsg_type generator =
-                RNG::make_sequence_generator(dimensions * (grid.size() - 1),
-                                             MCDiscreteAveragingAsianEngineBase<SingleVariate,RNG,S>::seed_);
-
-            // Branche "constant" ?
-            if (this->constantParameters) {
-                // On cast en GeneralizedBlackScholesProcess
-                auto BS_process = ext::dynamic_pointer_cast<GeneralizedBlackScholesProcess>(
-                    this->process_
-                );
-                QL_REQUIRE(BS_process, "Need a GenBlackScholesProcess for constantParameters");
-
-                // On prend le temps final de la grille
-                Time time_of_extraction = grid.back();
-
-                // Récupération du strike (si besoin)
-                double strike = ext::dynamic_pointer_cast<StrikedTypePayoff>(
-                    this->arguments_.payoff
-                )->strike();
-
-                // On construit un "ConstantBlackScholesProcess" 
-                // via votre fonction factorisée ou direct:
-                auto cst_BS_process = makeConstantProcess( // si vous factorisez
-                    BS_process,
-                    time_of_extraction,
-                    strike
-                );
+            return makePathGenerator(
+                MCDiscreteAveragingAsianEngineBase<SingleVariate,RNG,S>::seed_);
+        }
 
-                return ext::make_shared<path_generator_type>(
-                    cst_BS_process, grid, generator,
-                    MCDiscreteAveragingAsianEngineBase<SingleVariate,RNG,S>::brownianBridge_
-                );
-            } else {
-                // Sinon, on renvoie le path_generator classique
-                return ext::make_shared<path_generator_type>(
-                    this->process_, grid, generator,
-                    MCDiscreteAveragingAsianEngineBase<SingleVariate,RNG,S>::brownianBridge_
-                );
-            }
+        DiscountFactor discount() const { return discount_; }
+
+        Option::Type optionType() const {
+            auto payoff = ext::dynamic_pointer_cast<PlainVanillaPayoff>(this->arguments_.payoff);
+            QL_REQUIRE(payoff, "non-plain payoff given");
+            return payoff->optionType();
         }
 
       protected:
+        // la grille préparée par calculate(), voir setupTimeGrid()
+        TimeGrid timeGrid() const override {
+            // hors de calculate(), avant toute simulation : grille construite
+            // à la demande
+            if (grid_.empty())
+                return MCDiscreteAveragingAsianEngineBase<SingleVariate,RNG,S>::timeGrid();
+            return grid_;
+        }
+
         // Surcharge du pathPricer()
         ext::shared_ptr<path_pricer_type> pathPricer() const override;
+
+        // Variable de contrôle : l'option à strike moyen géométrique,
+        // simulée sur les mêmes chemins
+        ext::shared_ptr<path_pricer_type> controlPathPricer() const override {
+            return ext::make_shared<GeometricASOPathPricer>(optionType(), discount());
+        }
+        // ... et sa valeur exacte sous la dynamique simulée
+        Real controlVariateValue() const override;
+    };
+
+
+    //! Batch version of ArithmeticASOPathPricer
+    /*! Same averaging convention: the first node is part of the average
+        only when the first fixing is at time 0.
+    */
+    class ArithmeticASOBatchPathPricer : public BatchPathPricer {
+      public:
+        ArithmeticASOBatchPathPricer(Option::Type type,
+                                     DiscountFactor discount,
+                                     Real runningSum = 0.0,
+                                     Size pastFixings = 0)
+        : type_(type), discount_(discount),
+          runningSum_(runningSum), pastFixings_(pastFixings) {}
+        void operator()(const PathBlock& paths, Real* values) const override {
+            Size n = paths.length(), size = paths.size();
+            QL_REQUIRE(n > 1, "the path cannot be empty");
+            Size first = paths.timeGrid().mandatoryTimes()[0] == 0.0 ? 0 : 1;
+            Real fixings = Real(pastFixings_ + n - first);
+            // la somme des fixings est accumulée directement dans values
+            std::fill(values, values + size, runningSum_);
+            for (Size i = first; i < n; ++i) {
+                const Real* node = paths.node(i);
+                for (Size p = 0; p < size; ++p)
+                    values[p] += node[p];
+            }
+            // payoff de PlainVanillaPayoff(type, moyenne), sans construire
+            // un payoff par chemin
+            const Real* last = paths.node(n - 1);
+            const Real sign = (type_ == Option::Call) ? 1.0 : -1.0;
+            for (Size p = 0; p < size; ++p)
+                values[p] = discount_ *
+                    std::max(sign * (last[p] - values[p] / fixings), 0.0);
+        }
+      private:
+        Option::Type type_;
+        DiscountFactor discount_;
+        Real runningSum_;
+        Size pastFixings_;
+    };
+
+    //! ArithmeticASOPathPricer with pathwise delta and vega and LR gamma
+    /*! For paths of the given constant process; the average strike moves
+        with the simulated fixings only, and gamma uses the density of
+        the first step.
+    */
+    class ArithmeticASOGreekPathPricer : public GreekPathPricer {
+      public:
+        ArithmeticASOGreekPathPricer(Option::Type type,
+                                     DiscountFactor discount,
+                                     const ConstantBlackScholesProcess& process,
+                                     Real runningSum = 0.0,
+                                     Size pastFixings = 0)
+        : sign_(type == Option::Call ? 1.0 : -1.0), discount_(discount),
+          logDrift_(process.logDrift()), volatility_(process.volatility()),
+          runningSum_(runningSum), pastFixings_(pastFixings) {
+            QL_REQUIRE(volatility_ > 0.0, "positive volatility required for greeks");
+        }
+        PathGreeks greeks(const Path& path) const override {
+            Size n = path.length();
+            QL_REQUIRE(n > 1, "the path cannot be empty");
+            const TimeGrid& grid = path.timeGrid();
+            Size first = grid.mandatoryTimes()[0] == 0.0 ? 0 : 1;
+            Real fixings = Real(pastFixings_ + n - first);
+            // somme des fixings simulés et de leurs dS_i/dsigma
+            Real sum = 0.0, vegaSum = 0.0, spotVega = 0.0;
+            for (Size i = first; i < n; ++i) {
+                Real w = brownianMotionAt(path, i, logDrift_, volatility_);
+                spotVega = path[i] * (w - volatility_ * (grid[i] - grid.front()));
+                sum += path[i];
+                vegaSum += spotVega;
+            }
+            Real x0 = path.front(), spot = path.back();
+            Real average = (runningSum_ + sum) / fixings;
+            // discount * dPayoff/d(S_T - moyenne)
+            Real slope = sign_ * (spot - average) > 0.0 ? sign_ * discount_ : 0.0;
+            PathGreeks greeks;
+            greeks.value = discount_ * std::max(sign_ * (spot - average), 0.0);
+            greeks.delta = slope * (spot - sum / fixings) / x0;
+            greeks.vega = slope * (spotVega - vegaSum / fixings);
+            Time dt = grid.dt(0);
+            greeks.gamma = greeks.value * likelihoodRatioGammaWeight(
+                brownianMotionAt(path, 1, logDrift_, volatility_) / std::sqrt(dt),
+                x0, volatility_, dt);
+            return greeks;
+        }
+      private:
+        Real sign_;
+        DiscountFactor discount_;
+        Real logDrift_;
+        Volatility volatility_;
+        Real runningSum_;
+        Size pastFixings_;
     };
 
 
@@ -106,14 +334,165 @@ namespace QuantLib {
              Real requiredTolerance,
              Size maxSamples,
              BigNatural seed,
-             bool constantParameters)
+             McEngineOptions options)
     : MCDiscreteAveragingAsianEngineBase<SingleVariate,RNG,S>(
           process, brownianBridge, antitheticVariate,
-          false,  // controlVariate
+          options.controlVariate,
           requiredSamples, requiredTolerance, maxSamples, seed
       ),
-      constantParameters(constantParameters)
+      process_mixin(std::move(options))
     {
+        // les incompatibilités communes sont vérifiées par le mixin
+        QL_REQUIRE(!options_.terminalSampling,
+                   "terminal sampling not available for Asian options");
+        // le payoff ne lit que les fixings et evolve() est exact entre
+        // deux fixings sur les marchés du repo : les corrections MLMC
+        // seraient toutes nulles
+        QL_REQUIRE(options_.levels == 0,
+                   "multilevel simulation not available for Asian options");
+    }
+
+    // ------------------------------------------------------------------------
+    // Implementation du calculate() (multithread si threads > 1,
+    // simulation par blocs si batchSize > 0)
+    // ------------------------------------------------------------------------
+    template <class RNG, class S>
+    inline void MCDiscreteArithmeticASEngine_2<RNG,S>::calculate() const {
+        // (valeur, erreur) ; en QMC randomisé, un modèle par brouillage.
+        // Le cas série passe aussi par simulateModels (même boucle que
+        // McSimulation) pour compter les allocations.
+        QL_MC_PROFILE_ONLY(McCalculationProfile calculationProfile);
+        QL_MC_PROFILE_ONLY(constantProcessCache_.resetProfile());
+        // grille et actualisation, une fois pour tout le calcul
+        setupTimeGrid();
+        std::pair<Real, Real> result;
+        // valeur exacte de la variable de contrôle, calculée une fois
+        Real controlValue = this->controlVariate_ ? controlVariateValue() : 0.0;
+        if (options_.batchSize > 0) {
+            ext::shared_ptr<BatchPathPricer> batchPricer =
+                ext::make_shared<ArithmeticASOBatchPathPricer>(
+                    optionType(),
+                    discount(),
+                    this->arguments_.runningAccumulator,
+                    this->arguments_.pastFixings
+                );
+            ext::shared_ptr<BatchPathPricer> controlPricer;
+            if (this->controlVariate_)
+                controlPricer = ext::make_shared<GeometricASOBatchPathPricer>(
+                    optionType(), discount());
+            auto makeModel = [&](Size i) {
+                return ext::make_shared<BatchMonteCarloModel<RNG,S> >(
+                    makeBatchPathGenerator(deriveSeed(this->seed_, i)),
+                    batchPricer, this->antitheticVariate_,
+                    controlPricer, controlValue
+                );
+            };
+            result = simulate(makeModel);
+        } else if (options_.constantParameters && !options_.scenarios.empty()) {
+            // le choc de taux s'applique aussi à l'actualisation
+            Time maturity = this->process_->time(
+                this->arguments_.exercise->lastDate());
+            result = simulateScenarios(
+                [&](const MarketScenario& scenario,
+                    const ConstantBlackScholesProcess&)
+                        -> ext::shared_ptr<path_pricer_type> {
+                    return ext::make_shared<ArithmeticASOPathPricer>(
+                        optionType(),
+                        discount() * std::exp(-scenario.rateShift * maturity),
+                        this->arguments_.runningAccumulator,
+                        this->arguments_.pastFixings);
+                });
+        } else {
+            ext::shared_ptr<path_pricer_type> controlPricer;
+            if (this->controlVariate_)
+                controlPricer = controlPathPricer();
+            auto makePricer = [this](Size) { return this->pathPricer(); };
+            if (options_.constantParameters && options_.greeks)
+                result = simulateWithGreeks(
+                    ext::make_shared<ArithmeticASOGreekPathPricer>(
+                        optionType(), discount(), *constantProcess(),
+                        this->arguments_.runningAccumulator,
+                        this->arguments_.pastFixings),
+                    controlPricer, controlValue);
+            else if (options_.constantParameters)
+                result = simulateLogNormalPaths(constantProcess(), makePricer,
+                                                controlPricer, controlValue);
+            else if (options_.piecewiseParameters)
+                result = simulateLogNormalPaths(piecewiseProcess(), makePricer,
+                                                controlPricer, controlValue);
+            else
+                result = simulatePaths(makePricer, controlPricer, controlValue);
+        }
+
+        this->results_.value = result.first;
+        if (RNG::allowsErrorEstimate)
+            this->results_.errorEstimate = result.second;
+        addGreekAndScenarioResults(this->results_);
+        QL_MC_PROFILE_ONLY(calculationProfile.finish(
+            samplingReport_.profile, constantProcessCache_.profile(),
+            samplingReport_.elapsedTime,
+            this->results_.additionalResults));
+    }
+
+    // ------------------------------------------------------------------------
+    // Valeur exacte de l'option à strike moyen géométrique : ln S aux
+    // fixings est gaussien, de moyenne et de variance (cumulée) données par
+    // le process constant (ou constant par intervalle) ou, sinon, par les
+    // courbes de taux et de vol.
+    // ------------------------------------------------------------------------
+    template <class RNG, class S>
+    inline Real MCDiscreteArithmeticASEngine_2<RNG,S>::controlVariateValue() const {
+        const TimeGrid& grid = grid_;
+        Size first = grid.mandatoryTimes()[0] == 0.0 ? 0 : 1;
+        std::vector<Real> logMeans, variances;
+        logMeans.reserve(grid.size() - first);
+        variances.reserve(grid.size() - first);
+
+        if (options_.constantParameters) {
+            auto cst_BS_process = constantProcess();
+            Real logX0 = std::log(cst_BS_process->x0());
+            Real sigma = cst_BS_process->volatility();
+            for (Size i = first; i < grid.size(); ++i) {
+                logMeans.push_back(logX0 + cst_BS_process->logDrift() * grid[i]);
+                variances.push_back(sigma * sigma * grid[i]);
+            }
+        } else if (options_.piecewiseParameters) {
+            // moments cumulés intervalle par intervalle
+            auto pw_BS_process = piecewiseProcess();
+            Real logMean = std::log(pw_BS_process->x0()), variance = 0.0;
+            for (Size i = 0; i < grid.size(); ++i) {
+                if (i > 0) {
+                    Real sigma = pw_BS_process->volatility(i - 1);
+                    logMean  += pw_BS_process->logDrift(i - 1) * grid.dt(i - 1);
+                    variance += sigma * sigma * grid.dt(i - 1);
+                }
+                if (i >= first) {
+                    logMeans.push_back(logMean);
+                    variances.push_back(variance);
+                }
+            }
+        } else {
+            auto process = ext::dynamic_pointer_cast<GeneralizedBlackScholesProcess>(this->process_);
+            QL_REQUIRE(process, "Black-Scholes process required");
+            // seul cas où la simulation est log-normale à variance
+            // déterministe (évolution exacte du process)
+            const auto& vol = process->blackVolatility().currentLink();
+            QL_REQUIRE(ext::dynamic_pointer_cast<BlackConstantVol>(vol) ||
+                       ext::dynamic_pointer_cast<BlackVarianceCurve>(vol),
+                       "control variate requires a strike-independent "
+                       "volatility or constant parameters");
+            Real logX0 = std::log(process->x0());
+            for (Size i = first; i < grid.size(); ++i) {
+                Time t = grid[i];
+                Real variance = vol->blackVariance(t, process->x0(), true);
+                logMeans.push_back(logX0
+                    + std::log(process->dividendYield()->discount(t)
+                               / process->riskFreeRate()->discount(t))
+                    - 0.5 * variance);
+                variances.push_back(variance);
+            }
+        }
+        return discount() * geometricAverageStrikeValue(optionType(), logMeans, variances);
     }
 
     // ------------------------------------------------------------------------
@@ -136,8 +515,8 @@ namespace QuantLib {
         // On construit un ArithmeticASOPathPricer (dérivé concret)
         // Supposez qu'il existe un tel constructeur :
         //   ArithmeticASOPathPricer(Option::Type, DiscountFactor, Real runningAcc, Size pastFixings)
-        // ou proche
-        DiscountFactor disc = process->riskFreeRate()->discount(exercise->lastDate());
+        // ou proche ; actualisation calculée une fois par setupTimeGrid()
+        DiscountFactor disc = discount();
 
         return ext::shared_ptr<path_pricer_type>(
             new ArithmeticASOPathPricer(
@@ -176,6 +555,22 @@ namespace QuantLib {
         MakeMCDiscreteArithmeticASEngine_2& withSeed(BigNatural seed);
         MakeMCDiscreteArithmeticASEngine_2& withAntitheticVariate(bool b = true);
         MakeMCDiscreteArithmeticASEngine_2& withConstantParameters(bool constantParameters);
+        MakeMCDiscreteArithmeticASEngine_2& withThreads(Size n);
+        MakeMCDiscreteArithmeticASEngine_2& withBatchSize(Size n);
+        MakeMCDiscreteArithmeticASEngine_2& withScrambles(Size n);
+        MakeMCDiscreteArithmeticASEngine_2& withControlVariate(bool b = true);
+        MakeMCDiscreteArithmeticASEngine_2& withPiecewiseConstantParameters(bool b = true);
+        //! delta, gamma et vega dans le même calcul (process constant)
+        MakeMCDiscreteArithmeticASEngine_2& withGreeks(bool b = true);
+        //! scénarios choqués pricés sur les mêmes chemins (process constant)
+        MakeMCDiscreteArithmeticASEngine_2& withScenarios(
+                                  std::vector<MarketScenario> scenarios);
+        //! normales des blocs recentrées et réduites (batchSize > 0)
+        MakeMCDiscreteArithmeticASEngine_2& withMomentMatching(bool b = true);
+        //! brownien terminal stratifié en n strates (batchSize > 0)
+        MakeMCDiscreteArithmeticASEngine_2& withStratification(Size strata);
+        //! chemins des blocs en float (batchSize > 0)
+        MakeMCDiscreteArithmeticASEngine_2& withSinglePrecision(bool b = true);
 
         operator ext::shared_ptr<PricingEngine>() const;
 
@@ -186,7 +581,7 @@ namespace QuantLib {
         Real tolerance_;
         bool brownianBridge_  = true;
         BigNatural seed_      = 0;
-        bool constantParameters_;
+        McEngineOptions options_;
     };
 
     // Constructor
@@ -196,7 +591,7 @@ namespace QuantLib {
         ext::shared_ptr<GeneralizedBlackScholesProcess> process)
     : process_(std::move(process)),
       samples_(Null<Size>()), maxSamples_(Null<Size>()),
-      tolerance_(Null<Real>()), constantParameters_(false)
+      tolerance_(Null<Real>())
     {}
 
     // Named parameters
@@ -249,7 +644,80 @@ namespace QuantLib {
     template <class RNG, class S>
     inline MakeMCDiscreteArithmeticASEngine_2<RNG,S>&
     MakeMCDiscreteArithmeticASEngine_2<RNG,S>::withConstantParameters(bool constantParameters) {
-        constantParameters_ = constantParameters;
+        options_.constantParameters = constantParameters;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCDiscreteArithmeticASEngine_2<RNG,S>&
+    MakeMCDiscreteArithmeticASEngine_2<RNG,S>::withThreads(Size n) {
+        QL_REQUIRE(n > 0, "at least one thread required");
+        options_.threads = n;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCDiscreteArithmeticASEngine_2<RNG,S>&
+    MakeMCDiscreteArithmeticASEngine_2<RNG,S>::withBatchSize(Size n) {
+        options_.batchSize = n;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCDiscreteArithmeticASEngine_2<RNG,S>&
+    MakeMCDiscreteArithmeticASEngine_2<RNG,S>::withScrambles(Size n) {
+        QL_REQUIRE(n > 1, "at least two scrambles required");
+        options_.scrambles = n;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCDiscreteArithmeticASEngine_2<RNG,S>&
+    MakeMCDiscreteArithmeticASEngine_2<RNG,S>::withControlVariate(bool b) {
+        options_.controlVariate = b;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCDiscreteArithmeticASEngine_2<RNG,S>&
+    MakeMCDiscreteArithmeticASEngine_2<RNG,S>::withPiecewiseConstantParameters(bool b) {
+        options_.piecewiseParameters = b;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCDiscreteArithmeticASEngine_2<RNG,S>&
+    MakeMCDiscreteArithmeticASEngine_2<RNG,S>::withGreeks(bool b) {
+        options_.greeks = b;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCDiscreteArithmeticASEngine_2<RNG,S>&
+    MakeMCDiscreteArithmeticASEngine_2<RNG,S>::withScenarios(
+                                  std::vector<MarketScenario> scenarios) {
+        options_.scenarios = std::move(scenarios);
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCDiscreteArithmeticASEngine_2<RNG,S>&
+    MakeMCDiscreteArithmeticASEngine_2<RNG,S>::withMomentMatching(bool b) {
+        options_.batchSampling.momentMatching = b;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCDiscreteArithmeticASEngine_2<RNG,S>&
+    MakeMCDiscreteArithmeticASEngine_2<RNG,S>::withStratification(Size strata) {
+        options_.batchSampling.strata = strata;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCDiscreteArithmeticASEngine_2<RNG,S>&
+    MakeMCDiscreteArithmeticASEngine_2<RNG,S>::withSinglePrecision(bool b) {
+        options_.singlePrecision = b;
         return *this;
     }
 
@@ -265,7 +733,7 @@ namespace QuantLib {
                 samples_, tolerance_,
                 maxSamples_,
                 seed_,
-                constantParameters_
+                options_
             )
         );
     }
@@ -0,0 +1,194 @@
+#ifndef QL_MCALLOCATIONCOUNTER_HPP
+#define QL_MCALLOCATIONCOUNTER_HPP
+
+#include <ql/shared_ptr.hpp>
+#include <ql/types.hpp>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "batchpathgenerator.hpp"
+#include "mcgreeks.hpp"
+#include "mcprofiler.hpp"
+#include "mcscenarios.hpp"
+
+namespace QuantLib {
+
+    //------------------------------------------------------------------------
+    // Heap allocation counter for the sampling loops.
+    //   - the count is kept per thread, so that each worker only sees the
+    //     allocations made by its own paths
+    //   - it is only incremented in programs where exactly one translation
+    //     unit defines QL_MC_COUNT_HEAP_ALLOCATIONS before including this
+    //     header, which replaces the global operator new (plain and
+    //     aligned); elsewhere it stays at zero
+    //   - tests/allocations.cpp is such a program: "make test-alloc"
+    //     fails if any engine and mode allocates while sampling
+    //------------------------------------------------------------------------
+
+    namespace detail {
+
+        inline Size& heapAllocationCount() {
+            static thread_local Size count = 0;
+            return count;
+        }
+
+        template <class S, class = void>
+        struct has_reserve : std::false_type {};
+
+        template <class S>
+        struct has_reserve<S, decltype(void(std::declval<const S&>().reserve(Size())))>
+        : std::true_type {};
+
+    }
+
+    //! heap allocations made so far by the calling thread
+    inline Size threadHeapAllocations() {
+        return detail::heapAllocationCount();
+    }
+
+    //! makes room for \c samples samples in accumulators storing them
+    /*! GeneralStatistics and the Statistics class built on it grow a
+        vector of samples; other accumulators are left alone.
+    */
+    template <class S>
+    inline void reserveSamples(const S& stats, Size samples) {
+        if constexpr (detail::has_reserve<S>::value)
+            stats.reserve(samples);
+    }
+
+    //! Monte Carlo model counting the heap allocations of its samples
+    /*! Forwards to the wrapped model; before each addSamples() call the
+        accumulator is resized for the new samples, so that the count only
+        covers path generation, pricing and accumulation.
+    */
+    template <class Model>
+    class AllocationCountingModel {
+      public:
+        typedef typename std::decay<
+            decltype(std::declval<const Model&>().sampleAccumulator())>::type
+            stats_type;
+
+        explicit AllocationCountingModel(ext::shared_ptr<Model> model)
+        : model_(std::move(model)), allocations_(0) {}
+        void addSamples(Size samples) {
+            reserveSamples(model_->sampleAccumulator(),
+                           model_->sampleAccumulator().samples() + samples);
+            Size before = threadHeapAllocations();
+            model_->addSamples(samples);
+            allocations_ += threadHeapAllocations() - before;
+        }
+        const stats_type& sampleAccumulator() const {
+            return model_->sampleAccumulator();
+        }
+        //! heap allocations made by addSamples() so far
+        Size allocations() const { return allocations_; }
+        McProfile profile() const { return profileOf(*model_); }
+        GreekStatistics greeks() const { return greeksOf(*model_); }
+        std::vector<StreamingStatistics> scenarios() const {
+            return scenariosOf(*model_);
+        }
+        StreamingStatistics groupStatistics() const {
+            return groupStatisticsOf(*model_);
+        }
+      private:
+        ext::shared_ptr<Model> model_;
+        Size allocations_;
+    };
+
+    //! total allocations of a set of counting models
+    template <class Model>
+    inline Size countedAllocations(
+          const std::vector<ext::shared_ptr<AllocationCountingModel<Model> > >& models) {
+        Size n = 0;
+        for (const auto& m : models)
+            n += m->allocations();
+        return n;
+    }
+
+    //! summed profiles of a set of counting models
+    template <class Model>
+    inline McProfile countedProfile(
+          const std::vector<ext::shared_ptr<AllocationCountingModel<Model> > >& models) {
+        McProfile profile;
+        for (const auto& m : models)
+            profile += m->profile();
+        return profile;
+    }
+
+    //! pooled greeks of a set of counting models
+    template <class Model>
+    inline GreekStatistics countedGreeks(
+          const std::vector<ext::shared_ptr<AllocationCountingModel<Model> > >& models) {
+        GreekStatistics greeks;
+        for (const auto& m : models)
+            greeks.merge(m->greeks());
+        return greeks;
+    }
+
+    //! pooled group averages of a set of counting models
+    template <class Model>
+    inline StreamingStatistics countedGroupStatistics(
+          const std::vector<ext::shared_ptr<AllocationCountingModel<Model> > >& models) {
+        StreamingStatistics groups;
+        for (const auto& m : models)
+            groups.merge(m->groupStatistics());
+        return groups;
+    }
+
+    //! pooled scenario accumulators of a set of counting models
+    template <class Model>
+    inline std::vector<StreamingStatistics> countedScenarios(
+          const std::vector<ext::shared_ptr<AllocationCountingModel<Model> > >& models) {
+        std::vector<StreamingStatistics> scenarios;
+        for (const auto& m : models)
+            mergeScenarios(scenarios, m->scenarios());
+        return scenarios;
+    }
+
+} // namespace QuantLib
+
+#ifdef QL_MC_COUNT_HEAP_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+
+// The array and nothrow forms of new forward to these by default, and
+// so do the sized deletes; the aligned forms (over-aligned types, e.g.
+// SIMD buffers) are replaced too, so that every allocation is counted.
+void* operator new(std::size_t size) {
+    ++QuantLib::detail::heapAllocationCount();
+    if (void* p = std::malloc(size != 0 ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    ++QuantLib::detail::heapAllocationCount();
+    std::size_t a = static_cast<std::size_t>(alignment);
+    // aligned_alloc wants a size multiple of the alignment
+    std::size_t n = size != 0 ? (size + a - 1) / a * a : a;
+    if (void* p = std::aligned_alloc(a, n))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+#endif
+
+#endif
@@ -6,23 +6,35 @@
 #include <ql/pricingengines/mcsimulation.hpp>
 #include <ql/pricingengines/barrier/mcbarrierengine.hpp>
 #include <ql/processes/blackscholesprocess.hpp>
+#include <cmath>
 #include <utility>
 
 // On inclut le helper factorisé (sans eps)
 #include "myconstutil.hpp"
 #include "constantblackscholesprocess.hpp"
+#include "mcparallel.hpp"
+#include "batchpathgenerator.hpp"
+#include "mcrandomizedqmc.hpp"
+#include "philoxrng.hpp"
+#include "mcmultilevel.hpp"
+#include "mcpathmodel.hpp"
+#include "lognormalpathgenerator.hpp"
+#include "mcscenarios.hpp"
+#include "mcconstantprocesshelper.hpp"
 
 namespace QuantLib {
 
     //! Pricing engine for barrier options using Monte Carlo simulation
     template <class RNG = PseudoRandom, class S = Statistics>
     class MCBarrierEngine_2 : public BarrierOption::engine,
-                              public McSimulation<SingleVariate, RNG, S> {
+                              public McSimulation<SingleVariate, RNG, S>,
+                              public ConstantProcessEngineMixin<MCBarrierEngine_2<RNG, S>, RNG> {
     public:
         typedef typename McSimulation<SingleVariate, RNG, S>::path_generator_type path_generator_type;
         typedef typename McSimulation<SingleVariate, RNG, S>::path_pricer_type    path_pricer_type;
         typedef typename McSimulation<SingleVariate, RNG, S>::stats_type          stats_type;
 
+        //! options usually filled by MakeMCBarrierEngine_2
         MCBarrierEngine_2(ext::shared_ptr<GeneralizedBlackScholesProcess> process,
                           Size timeSteps,
                           Size timeStepsPerYear,
@@ -33,59 +45,134 @@ namespace QuantLib {
                           Size maxSamples,
                           bool isBiased,
                           BigNatural seed,
-                          bool constantParameters);
+                          McEngineOptions options = McEngineOptions());
+
+        //! heap allocations made while sampling in the last calculation
+        /*! Zero with a fixed number of samples; only counted in programs
+            built with QL_MC_COUNT_HEAP_ALLOCATIONS.
+        */
+        Size sampleAllocations() const {
+            return samplingReport_.sampleAllocations;
+        }
+
+        //! samples used and sampling time of the last calculation
+        /*! With a tolerance, elapsedTime is the time to tolerance. */
+        const SamplingReport& samplingReport() const {
+            return samplingReport_;
+        }
 
     private:
-        bool constantParameters;
+        typedef ConstantProcessEngineMixin<MCBarrierEngine_2, RNG> process_mixin;
+        friend class ConstantProcessEngineMixin<MCBarrierEngine_2, RNG>;
+        using process_mixin::constantProcess;
+        using process_mixin::piecewiseProcess;
+        using process_mixin::makePathGenerator;
+        using process_mixin::makeBatchPathGenerator;
+        using process_mixin::simulate;
+        using process_mixin::simulatePaths;
+        using process_mixin::simulateLogNormalPaths;
+        using process_mixin::simulateScenarios;
+        using process_mixin::addGreekAndScenarioResults;
+        using process_mixin::constantProcessCache_;
+        using process_mixin::options_;
 
         void calculate() const override {
+            QL_MC_PROFILE_ONLY(McCalculationProfile calculationProfile);
+            QL_MC_PROFILE_ONLY(constantProcessCache_.resetProfile());
             Real spot = process_->x0();
             QL_REQUIRE(spot > 0.0, "negative or null underlying given");
             QL_REQUIRE(!triggered(spot), "barrier touched");
-            McSimulation<SingleVariate, RNG, S>::calculate(requiredTolerance_,
-                requiredSamples_,
-                maxSamples_);
-            results_.value = this->mcModel_->sampleAccumulator().mean();
+            // grille et actualisations, une fois pour tout le calcul
+            setupTimeGrid();
+            // (valeur, erreur) ; en QMC randomisé, un modèle par brouillage.
+            // Le cas série passe aussi par simulateModels (même boucle que
+            // McSimulation) pour compter les allocations.
+            std::pair<Real, Real> result;
+            if (options_.levels > 0) {
+                // erreur d'échantillonnage seule : le biais de la grille la
+                // plus fine n'y est pas
+                result = simulateMultilevelPaths();
+                results_.additionalResults["levelSamples"] =
+                    samplingReport_.levelSamples;
+            } else if (options_.batchSize > 0) {
+                // le pricer a ses propres buffers : un par thread
+                auto makeModel = [this](Size i) {
+                    return ext::make_shared<BatchMonteCarloModel<RNG, S> >(
+                        makeBatchPathGenerator(deriveSeed(seed_, i)),
+                        makeBatchPathPricer(),
+                        this->antitheticVariate_);
+                };
+                result = simulate(makeModel);
+            } else if (options_.constantParameters && !options_.scenarios.empty()) {
+                result = simulateScenarios(
+                    [this](const MarketScenario& scenario,
+                           const ConstantBlackScholesProcess& process) {
+                        return makeScenarioPathPricer(scenario, process);
+                    });
+            } else {
+                // un pricer par modèle : le pricer non biaisé tire ses
+                // propres uniformes
+                auto makePricer = [this](Size i) {
+                    return makePathPricer(deriveSeed(5, i));
+                };
+                if (options_.constantParameters)
+                    result = simulateLogNormalPaths(constantProcess(), makePricer);
+                else if (options_.piecewiseParameters)
+                    result = simulateLogNormalPaths(piecewiseProcess(), makePricer);
+                else
+                    result = simulatePaths(makePricer);
+            }
+            results_.value = result.first;
             if (RNG::allowsErrorEstimate)
-                results_.errorEstimate =
-                this->mcModel_->sampleAccumulator().errorEstimate();
+                results_.errorEstimate = result.second;
+            addGreekAndScenarioResults(results_);
+            QL_MC_PROFILE_ONLY(calculationProfile.finish(
+                samplingReport_.profile, constantProcessCache_.profile(),
+                samplingReport_.elapsedTime,
+                results_.additionalResults));
         }
 
     protected:
-        // McSimulation implementation
+        // McSimulation implementation; the grid set up by calculate(),
+        // or a new one before the first calculation
         TimeGrid timeGrid() const override;
+        // the grid given by the time steps, built once per calculation
+        // by setupTimeGrid() along with the discount factors of its nodes
+        TimeGrid makeTimeGrid() const;
+        void setupTimeGrid() const;
+        // discount factors on the nodes of a grid: closed-form exp(-r t)
+        // with constant parameters, the tables of the process with
+        // piecewise-constant parameters (only on timeGrid()), the curve
+        // otherwise
+        std::vector<DiscountFactor> gridDiscounts(const TimeGrid& grid) const;
         ext::shared_ptr<path_generator_type> pathGenerator() const override {
-            TimeGrid grid = timeGrid();
-            typename RNG::rsg_type gen =
-                RNG::make_sequence_generator(grid.size() - 1, seed_);
-
-            if (constantParameters) {
-
-                auto BS_process = ext::dynamic_pointer_cast<GeneralizedBlackScholesProcess>(process_);
-                QL_REQUIRE(BS_process, "Need a GeneralizedBlackScholesProcess");
-
-                Time time_of_extraction = grid.back();
-                double strike = ext::dynamic_pointer_cast<StrikedTypePayoff>(arguments_.payoff)->strike();
-
-                // PAS DE + eps
-                auto cst_BS_process = makeConstantProcess(
-                    BS_process,
-                    time_of_extraction,
-                    strike
-                );
-
-                return ext::make_shared<path_generator_type>(
-                    cst_BS_process, grid, gen, brownianBridge_
-                );
-            }
-            else {
-                return ext::make_shared<path_generator_type>(
-                    process_, grid, gen, brownianBridge_
-                );
-            }
+            return makePathGenerator(seed_);
         }
 
-        ext::shared_ptr<path_pricer_type> pathPricer() const override;
+        ext::shared_ptr<path_pricer_type> pathPricer() const override {
+            return makePathPricer(5);
+        }
+        // the unbiased pricer draws its own uniforms, seeded with uniformSeed,
+        // except with constant parameters where crossings are weighted
+        ext::shared_ptr<path_pricer_type> makePathPricer(BigNatural uniformSeed) const {
+            return makePathPricer(uniformSeed, grid_, discounts_);
+        }
+        // same on another grid, discounted with gridDiscounts(grid); in
+        // piecewise-constant mode, only on timeGrid()
+        ext::shared_ptr<path_pricer_type> makePathPricer(
+                              BigNatural uniformSeed,
+                              const TimeGrid& grid,
+                              const std::vector<DiscountFactor>& discounts) const;
+
+        ext::shared_ptr<BatchPathPricer> makeBatchPathPricer() const;
+        // pricer of a bumped constant process; the crossings are weighted,
+        // not drawn, so the normals are the only random numbers and they
+        // are common to every scenario
+        ext::shared_ptr<path_pricer_type> makeScenarioPathPricer(
+                              const MarketScenario& scenario,
+                              const ConstantBlackScholesProcess& process) const;
+        // multi-level Monte Carlo, the engine grid being the finest
+        std::pair<Real, Real> simulateMultilevelPaths() const;
 
         // data members
         ext::shared_ptr<GeneralizedBlackScholesProcess> process_;
@@ -95,6 +182,105 @@ namespace QuantLib {
         bool isBiased_;
         bool brownianBridge_;
         BigNatural seed_;
+        mutable SamplingReport samplingReport_;
+        // grid of the current calculation and discount factors of its
+        // nodes, shared by the generators and pricers of every thread
+        mutable TimeGrid grid_;
+        mutable std::vector<DiscountFactor> discounts_;
+    };
+
+
+    //! Batch version of BarrierPathPricer and BiasedBarrierPathPricer
+    /*! Same crossing rules and knock-node discounting in the biased
+        case; in the unbiased case, each path is weighted by its
+        probability of crossing, as in BarrierSurvivalPathPricer.  Holds
+        scratch buffers, so each thread needs its own.
+    */
+    class BarrierBatchPathPricer : public BatchPathPricer {
+      public:
+        BarrierBatchPathPricer(Barrier::Type barrierType,
+                               Real barrier,
+                               Real rebate,
+                               Option::Type type,
+                               Real strike,
+                               std::vector<DiscountFactor> discounts,
+                               Volatility volatility,
+                               bool isBiased);
+        void operator()(const PathBlock& paths, Real* values) const override;
+      private:
+        Barrier::Type barrierType_;
+        Real barrier_;
+        Real rebate_;
+        PlainVanillaPayoff payoff_;
+        std::vector<DiscountFactor> discounts_;
+        Volatility volatility_;
+        bool isBiased_;
+        mutable std::vector<Size> knockNodes_;
+        mutable std::vector<Real> logDistances_, survival_, knockedRebate_;
+    };
+
+
+    //! Allocation-free version of BarrierPathPricer
+    /*! Same crossing probability and knock-node discounting, but the
+        uniforms are read in place instead of being copied for each path.
+    */
+    class BarrierPathPricer_2 : public PathPricer<Path> {
+      public:
+        BarrierPathPricer_2(Barrier::Type barrierType,
+                            Real barrier,
+                            Real rebate,
+                            Option::Type type,
+                            Real strike,
+                            std::vector<DiscountFactor> discounts,
+                            ext::shared_ptr<StochasticProcess1D> diffProcess,
+                            PseudoRandom::ursg_type sequenceGen);
+        Real operator()(const Path& path) const override;
+      private:
+        Barrier::Type barrierType_;
+        Real barrier_;
+        Real rebate_;
+        ext::shared_ptr<StochasticProcess1D> diffProcess_;
+        mutable PseudoRandom::ursg_type sequenceGen_;
+        PlainVanillaPayoff payoff_;
+        std::vector<DiscountFactor> discounts_;
+    };
+
+
+    //! probability that a Brownian bridge crosses the barrier on a step
+    /*! x and y are the log-distances ln(S/B) of the two nodes, on the
+        same side of the barrier; variance is sigma^2 dt of the step.
+    */
+    inline Real barrierCrossingProbability(Real x, Real y, Real variance) {
+        return std::exp(-2.0 * x * y / variance);
+    }
+
+    //! Barrier pricer for constant volatility, without random crossings
+    /*! Instead of drawing a uniform per step to decide whether the
+        barrier was crossed between two nodes, each path is weighted by
+        its probability of survival, the product over the steps of one
+        minus the closed-form crossing probability of the Brownian
+        bridge; a knock-out rebate is weighted by the probability of a
+        first crossing on each step and discounted at the end of it.
+        Same expectation as BarrierPathPricer, lower variance, and no
+        random numbers besides those of the path; stateless.
+    */
+    class BarrierSurvivalPathPricer : public PathPricer<Path> {
+      public:
+        BarrierSurvivalPathPricer(Barrier::Type barrierType,
+                                  Real barrier,
+                                  Real rebate,
+                                  Option::Type type,
+                                  Real strike,
+                                  std::vector<DiscountFactor> discounts,
+                                  Volatility volatility);
+        Real operator()(const Path& path) const override;
+      private:
+        Real barrier_;
+        Real rebate_;
+        bool down_, knockIn_;
+        PlainVanillaPayoff payoff_;
+        std::vector<DiscountFactor> discounts_;
+        Real variance_;
     };
 
 
@@ -114,14 +300,31 @@ namespace QuantLib {
         MakeMCBarrierEngine_2& withBias(bool b = true);
         MakeMCBarrierEngine_2& withSeed(BigNatural seed);
         MakeMCBarrierEngine_2& withConstantParameters(bool constantParameters);
+        MakeMCBarrierEngine_2& withThreads(Size n);
+        MakeMCBarrierEngine_2& withBatchSize(Size n);
+        MakeMCBarrierEngine_2& withScrambles(Size n);
+        MakeMCBarrierEngine_2& withPiecewiseConstantParameters(bool b = true);
+        MakeMCBarrierEngine_2& withScenarios(std::vector<MarketScenario> scenarios);
+        MakeMCBarrierEngine_2& withMomentMatching(bool b = true);
+        MakeMCBarrierEngine_2& withStratification(Size strata);
+        MakeMCBarrierEngine_2& withSinglePrecision(bool b = true);
+        //! constant parameters or biased pricer only
+        /*! The levels coarsen the engine grid, so withSteps() is required
+            and the steps must be divisible by 2^(levels-1).  The error
+            estimate is the sampling error only: it does not include the
+            bias of the finest grid.
+        */
+        MakeMCBarrierEngine_2& withMultilevel(Size levels);
         operator ext::shared_ptr<PricingEngine>() const;
     private:
         ext::shared_ptr<GeneralizedBlackScholesProcess> process_;
-        bool brownianBridge_ = false, antithetic_ = false, biased_ = false;
+        // pont brownien par défaut en QMC
+        bool brownianBridge_ = is_low_discrepancy<RNG>::value;
+        bool antithetic_ = false, biased_ = false;
         Size steps_, stepsPerYear_, samples_, maxSamples_;
         Real tolerance_;
         BigNatural seed_ = 0;
-        bool constantParameters_;
+        McEngineOptions options_;
     };
 
 
@@ -139,14 +342,15 @@ namespace QuantLib {
         Size maxSamples,
         bool isBiased,
         BigNatural seed,
-        bool constantParameters)
+        McEngineOptions options)
         : McSimulation<SingleVariate, RNG, S>(antitheticVariate, false),
+          process_mixin(std::move(options)),
           process_(std::move(process)),
           timeSteps_(timeSteps), timeStepsPerYear_(timeStepsPerYear),
           requiredSamples_(requiredSamples),
           maxSamples_(maxSamples), requiredTolerance_(requiredTolerance),
           isBiased_(isBiased), brownianBridge_(brownianBridge),
-          seed_(seed), constantParameters(constantParameters) 
+          seed_(seed)
     {
         QL_REQUIRE(timeSteps != Null<Size>() ||
             timeStepsPerYear != Null<Size>(),
@@ -158,11 +362,40 @@ namespace QuantLib {
             "timeSteps must be positive");
         QL_REQUIRE(timeStepsPerYear != 0,
             "timeStepsPerYear must be positive");
+        // les incompatibilités communes sont vérifiées par le mixin
+        QL_REQUIRE(!options_.greeks,
+            "greeks not available for barrier options");
+        QL_REQUIRE(!options_.terminalSampling,
+            "terminal sampling not available for barrier options");
+        QL_REQUIRE(!options_.controlVariate,
+            "control variate not available for barrier options");
+        // sur les courbes, le pricer non biaisé tire ses propres uniformes
+        // sur chaque grille : niveaux fin et grossier décorrélés
+        QL_REQUIRE(options_.levels == 0 || options_.constantParameters ||
+                   isBiased,
+            "multilevel simulation requires constant parameters "
+            "or a biased pricer");
         registerWith(process_);
     }
 
     template <class RNG, class S>
     inline TimeGrid MCBarrierEngine_2<RNG, S>::timeGrid() const {
+        // hors de calculate(), avant toute simulation : grille construite
+        // à la demande
+        if (grid_.empty())
+            return makeTimeGrid();
+        return grid_;
+    }
+
+    template <class RNG, class S>
+    inline void MCBarrierEngine_2<RNG, S>::setupTimeGrid() const {
+        grid_ = makeTimeGrid();
+        // le process constant (ou par intervalle) est extrait sur grid_
+        discounts_ = gridDiscounts(grid_);
+    }
+
+    template <class RNG, class S>
+    inline TimeGrid MCBarrierEngine_2<RNG, S>::makeTimeGrid() const {
 
         Time residualTime = process_->time(arguments_.exercise->lastDate());
         if (timeSteps_ != Null<Size>()) {
@@ -177,19 +410,49 @@ namespace QuantLib {
         }
     }
 
+    template <class RNG, class S>
+    inline std::vector<DiscountFactor>
+    MCBarrierEngine_2<RNG, S>::gridDiscounts(const TimeGrid& grid) const {
+        std::vector<DiscountFactor> discounts(grid.size());
+        if (options_.constantParameters) {
+            // le taux du process simulé, sans interroger la courbe
+            Rate r = constantProcess()->riskFreeRate();
+            for (Size i = 0; i < grid.size(); i++)
+                discounts[i] = std::exp(-r * grid[i]);
+        } else if (options_.piecewiseParameters) {
+            // tables du process au lieu des courbes
+            auto pw_BS_process = piecewiseProcess();
+            for (Size i = 0; i < grid.size(); i++)
+                discounts[i] = pw_BS_process->discount(i);
+        } else {
+            for (Size i = 0; i < grid.size(); i++)
+                discounts[i] = process_->riskFreeRate()->discount(grid[i]);
+        }
+        return discounts;
+    }
+
     template <class RNG, class S>
     inline
     ext::shared_ptr<typename MCBarrierEngine_2<RNG, S>::path_pricer_type>
-    MCBarrierEngine_2<RNG, S>::pathPricer() const {
+    MCBarrierEngine_2<RNG, S>::makePathPricer(
+                         BigNatural uniformSeed,
+                         const TimeGrid& grid,
+                         const std::vector<DiscountFactor>& discounts) const {
 
         ext::shared_ptr<PlainVanillaPayoff> payoff =
             ext::dynamic_pointer_cast<PlainVanillaPayoff>(arguments_.payoff);
         QL_REQUIRE(payoff, "non-plain payoff given");
-
-        TimeGrid grid = timeGrid();
-        std::vector<DiscountFactor> discounts(grid.size());
-        for (Size i = 0; i < grid.size(); i++)
-            discounts[i] = process_->riskFreeRate()->discount(grid[i]);
+        QL_REQUIRE(discounts.size() == grid.size(), "wrong number of discounts");
+
+        // en mode constant par intervalle, la vol vient des tables du
+        // process au lieu des courbes
+        ext::shared_ptr<PiecewiseConstantBlackScholesProcess> pw_BS_process;
+        if (options_.piecewiseParameters) {
+            pw_BS_process = piecewiseProcess();
+            if (options_.threads > 1)
+                pw_BS_process =
+                    ext::make_shared<PiecewiseConstantBlackScholesProcess>(*pw_BS_process);
+        }
 
         if (isBiased_) {
             return ext::shared_ptr<typename MCBarrierEngine_2<RNG, S>::path_pricer_type>(
@@ -201,23 +464,318 @@ namespace QuantLib {
                     payoff->strike(),
                     discounts));
         }
+        else if (options_.constantParameters) {
+            // probabilité de traversée exacte à vol constante : pas de
+            // tirage ni de courbe interrogée par pas
+            return ext::make_shared<BarrierSurvivalPathPricer>(
+                arguments_.barrierType,
+                arguments_.barrier,
+                arguments_.rebate,
+                payoff->optionType(),
+                payoff->strike(),
+                discounts,
+                constantProcess()->volatility());
+        }
         else {
             PseudoRandom::ursg_type sequenceGen(grid.size() - 1,
-                PseudoRandom::urng_type(5));
+                PseudoRandom::urng_type(uniformSeed));
             return ext::shared_ptr<typename MCBarrierEngine_2<RNG, S>::path_pricer_type>(
-                new BarrierPathPricer(
+                new BarrierPathPricer_2(
                     arguments_.barrierType,
                     arguments_.barrier,
                     arguments_.rebate,
                     payoff->optionType(),
                     payoff->strike(),
                     discounts,
-                    process_,
+                    pw_BS_process ?
+                        ext::shared_ptr<StochasticProcess1D>(pw_BS_process) :
+                        ext::shared_ptr<StochasticProcess1D>(process_),
                     sequenceGen));
         }
     }
 
 
+    template <class RNG, class S>
+    inline
+    ext::shared_ptr<typename MCBarrierEngine_2<RNG, S>::path_pricer_type>
+    MCBarrierEngine_2<RNG, S>::makeScenarioPathPricer(
+                       const MarketScenario& scenario,
+                       const ConstantBlackScholesProcess& process) const {
+
+        ext::shared_ptr<PlainVanillaPayoff> payoff =
+            ext::dynamic_pointer_cast<PlainVanillaPayoff>(arguments_.payoff);
+        QL_REQUIRE(payoff, "non-plain payoff given");
+
+        // le choc de taux s'applique aussi à l'actualisation
+        const TimeGrid& grid = grid_;
+        std::vector<DiscountFactor> discounts(grid.size());
+        for (Size i = 0; i < grid.size(); i++)
+            discounts[i] = discounts_[i] * std::exp(-scenario.rateShift * grid[i]);
+
+        if (isBiased_) {
+            return ext::make_shared<BiasedBarrierPathPricer>(
+                arguments_.barrierType,
+                arguments_.barrier,
+                arguments_.rebate,
+                payoff->optionType(),
+                payoff->strike(),
+                discounts);
+        }
+        return ext::make_shared<BarrierSurvivalPathPricer>(
+            arguments_.barrierType,
+            arguments_.barrier,
+            arguments_.rebate,
+            payoff->optionType(),
+            payoff->strike(),
+            discounts,
+            process.volatility());
+    }
+
+    // Level l is the engine grid coarsened levels-1-l times.  With constant
+    // parameters the pricer weights the crossings and the coupling is
+    // tight; the biased pricer only reads the path.  The unbiased pricer
+    // on curves would draw its own uniforms on each grid, which the coarse
+    // and fine paths do not share: the constructor refuses that case.
+    template <class RNG, class S>
+    inline std::pair<Real, Real>
+    MCBarrierEngine_2<RNG, S>::simulateMultilevelPaths() const {
+        std::vector<TimeGrid> grids(1, grid_);
+        std::vector<std::vector<DiscountFactor> > discounts(1, discounts_);
+        for (Size l = 1; l < options_.levels; ++l) {
+            grids.insert(grids.begin(), coarsenedTimeGrid(grids.front()));
+            discounts.insert(discounts.begin(), gridDiscounts(grids.front()));
+        }
+        auto makeModel = [&](Size level, Size i) {
+            Size k = level * (options_.threads + 1) + i;
+            ext::shared_ptr<StochasticProcess1D> process = process_;
+            if (options_.constantParameters)
+                process = constantProcess();
+            return ext::make_shared<MultilevelMonteCarloModel<RNG, S> >(
+                process, grids[level], grids[level > 0 ? level - 1 : 0],
+                makePathPricer(deriveSeed(5, k), grids[level], discounts[level]),
+                level > 0 ? makePathPricer(deriveSeed(7, k), grids[level - 1],
+                                           discounts[level - 1])
+                          : ext::shared_ptr<path_pricer_type>(),
+                this->antitheticVariate_, deriveSeed(seed_, k));
+        };
+        return simulateMultilevel(grids.size(), options_.threads,
+                                  makeModel,
+                                  requiredTolerance_,
+                                  requiredSamples_,
+                                  maxSamples_,
+                                  &samplingReport_);
+    }
+
+    template <class RNG, class S>
+    inline ext::shared_ptr<BatchPathPricer>
+    MCBarrierEngine_2<RNG, S>::makeBatchPathPricer() const {
+
+        ext::shared_ptr<PlainVanillaPayoff> payoff =
+            ext::dynamic_pointer_cast<PlainVanillaPayoff>(arguments_.payoff);
+        QL_REQUIRE(payoff, "non-plain payoff given");
+
+        return ext::make_shared<BarrierBatchPathPricer>(
+            arguments_.barrierType,
+            arguments_.barrier,
+            arguments_.rebate,
+            payoff->optionType(),
+            payoff->strike(),
+            discounts_,
+            constantProcess()->volatility(),
+            isBiased_);
+    }
+
+
+    inline BarrierPathPricer_2::BarrierPathPricer_2(
+        Barrier::Type barrierType,
+        Real barrier,
+        Real rebate,
+        Option::Type type,
+        Real strike,
+        std::vector<DiscountFactor> discounts,
+        ext::shared_ptr<StochasticProcess1D> diffProcess,
+        PseudoRandom::ursg_type sequenceGen)
+        : barrierType_(barrierType), barrier_(barrier), rebate_(rebate),
+          diffProcess_(std::move(diffProcess)),
+          sequenceGen_(std::move(sequenceGen)),
+          payoff_(type, strike), discounts_(std::move(discounts)) {
+        QL_REQUIRE(strike >= 0.0, "strike less than zero not allowed");
+        QL_REQUIRE(barrier > 0.0, "barrier less/equal zero not allowed");
+    }
+
+    inline Real BarrierPathPricer_2::operator()(const Path& path) const {
+        static const Size null = Null<Size>();
+        Size n = path.length();
+        QL_REQUIRE(n > 1, "the path cannot be empty");
+
+        bool down = (barrierType_ == Barrier::DownIn ||
+                     barrierType_ == Barrier::DownOut);
+        bool knockIn = (barrierType_ == Barrier::DownIn ||
+                        barrierType_ == Barrier::UpIn);
+
+        // one sequence per path, as in BarrierPathPricer, but not copied
+        const std::vector<Real>& u = sequenceGen_.nextSequence().value;
+        const TimeGrid& timeGrid = path.timeGrid();
+
+        // first node where the barrier is crossed, if any
+        Size knockNode = null;
+        for (Size i = 0; i < n - 1 && knockNode == null; ++i) {
+            Real assetPrice = path[i];
+            Volatility vol = diffProcess_->diffusion(timeGrid[i], assetPrice);
+            Real variance = 2.0 * vol * vol * timeGrid.dt(i);
+            Real x = std::log(path[i + 1] / assetPrice);
+            Real y;
+            if (down) {
+                y = 0.5 * (x - std::sqrt(x * x - variance * std::log(u[i])));
+                if (assetPrice * std::exp(y) <= barrier_)
+                    knockNode = i + 1;
+            } else {
+                y = 0.5 * (x + std::sqrt(x * x - variance * std::log(1.0 - u[i])));
+                if (assetPrice * std::exp(y) >= barrier_)
+                    knockNode = i + 1;
+            }
+        }
+
+        bool knocked = (knockNode != null);
+        if (knocked == knockIn)
+            return payoff_(path.back()) * discounts_.back();
+        else if (knockIn)
+            return rebate_ * discounts_.back();
+        else
+            return rebate_ * discounts_[knockNode];
+    }
+
+
+    inline BarrierSurvivalPathPricer::BarrierSurvivalPathPricer(
+        Barrier::Type barrierType,
+        Real barrier,
+        Real rebate,
+        Option::Type type,
+        Real strike,
+        std::vector<DiscountFactor> discounts,
+        Volatility volatility)
+        : barrier_(barrier), rebate_(rebate),
+          down_(barrierType == Barrier::DownIn ||
+                barrierType == Barrier::DownOut),
+          knockIn_(barrierType == Barrier::DownIn ||
+                   barrierType == Barrier::UpIn),
+          payoff_(type, strike), discounts_(std::move(discounts)),
+          variance_(volatility * volatility) {
+        QL_REQUIRE(strike >= 0.0, "strike less than zero not allowed");
+        QL_REQUIRE(barrier > 0.0, "barrier less/equal zero not allowed");
+        QL_REQUIRE(volatility > 0.0, "positive volatility required");
+    }
+
+    inline Real BarrierSurvivalPathPricer::operator()(const Path& path) const {
+        Size n = path.length();
+        QL_REQUIRE(n > 1, "the path cannot be empty");
+        const TimeGrid& timeGrid = path.timeGrid();
+
+        // probability of no crossing up to the current node, and rebate
+        // of the paths first knocked out on each step
+        Real survival = 1.0, knockedRebate = 0.0;
+        Real x = std::log(path[0] / barrier_);
+        for (Size i = 0; i < n - 1 && survival > 0.0; ++i) {
+            Real y = std::log(path[i + 1] / barrier_);
+            Real p = (down_ ? y <= 0.0 : y >= 0.0) ? 1.0 :
+                barrierCrossingProbability(x, y, variance_ * timeGrid.dt(i));
+            knockedRebate += survival * p * discounts_[i + 1];
+            survival *= 1.0 - p;
+            x = y;
+        }
+
+        Real value = payoff_(path.back()) * discounts_.back();
+        if (knockIn_)
+            return (1.0 - survival) * value
+                 + survival * rebate_ * discounts_.back();
+        else
+            return survival * value + rebate_ * knockedRebate;
+    }
+
+
+    inline BarrierBatchPathPricer::BarrierBatchPathPricer(
+        Barrier::Type barrierType,
+        Real barrier,
+        Real rebate,
+        Option::Type type,
+        Real strike,
+        std::vector<DiscountFactor> discounts,
+        Volatility volatility,
+        bool isBiased)
+        : barrierType_(barrierType), barrier_(barrier), rebate_(rebate),
+          payoff_(type, strike), discounts_(std::move(discounts)),
+          volatility_(volatility), isBiased_(isBiased) {
+        QL_REQUIRE(barrier_ > 0.0, "barrier less/equal to zero not allowed");
+        QL_REQUIRE(strike >= 0.0, "strike less than zero not allowed");
+        QL_REQUIRE(isBiased || volatility > 0.0, "positive volatility required");
+    }
+
+    inline void BarrierBatchPathPricer::operator()(const PathBlock& paths,
+                                                   Real* values) const {
+        static const Size null = Null<Size>();
+        Size n = paths.length(), size = paths.size();
+        QL_REQUIRE(n > 1, "the path cannot be empty");
+        QL_REQUIRE(discounts_.size() == n, "wrong number of discounts");
+
+        bool down = (barrierType_ == Barrier::DownIn ||
+                     barrierType_ == Barrier::DownOut);
+        bool knockIn = (barrierType_ == Barrier::DownIn ||
+                        barrierType_ == Barrier::UpIn);
+        const Real* last = paths.node(n - 1);
+
+        if (isBiased_) {
+            // first node where the barrier is crossed, if any
+            knockNodes_.assign(size, null);
+            for (Size i = 0; i < n - 1; ++i) {
+                const Real* next = paths.node(i + 1);
+                for (Size p = 0; p < size; ++p) {
+                    if (knockNodes_[p] == null &&
+                        (down ? next[p] <= barrier_ : next[p] >= barrier_))
+                        knockNodes_[p] = i + 1;
+                }
+            }
+            for (Size p = 0; p < size; ++p) {
+                bool knocked = (knockNodes_[p] != null);
+                if (knocked == knockIn)
+                    values[p] = payoff_(last[p]) * discounts_.back();
+                else if (knockIn)
+                    values[p] = rebate_ * discounts_.back();
+                else
+                    values[p] = rebate_ * discounts_[knockNodes_[p]];
+            }
+            return;
+        }
+
+        // survival weights, as in BarrierSurvivalPathPricer
+        logDistances_.resize(size);
+        survival_.assign(size, 1.0);
+        knockedRebate_.assign(size, 0.0);
+        const Real* first = paths.node(0);
+        for (Size p = 0; p < size; ++p)
+            logDistances_[p] = std::log(first[p] / barrier_);
+        for (Size i = 0; i < n - 1; ++i) {
+            const Real* next = paths.node(i + 1);
+            Real variance = volatility_ * volatility_ * paths.timeGrid().dt(i);
+            for (Size p = 0; p < size; ++p) {
+                Real y = std::log(next[p] / barrier_);
+                Real q = (down ? y <= 0.0 : y >= 0.0) ? 1.0 :
+                    barrierCrossingProbability(logDistances_[p], y, variance);
+                knockedRebate_[p] += survival_[p] * q * discounts_[i + 1];
+                survival_[p] *= 1.0 - q;
+                logDistances_[p] = y;
+            }
+        }
+        for (Size p = 0; p < size; ++p) {
+            Real value = payoff_(last[p]) * discounts_.back();
+            if (knockIn)
+                values[p] = (1.0 - survival_[p]) * value
+                          + survival_[p] * rebate_ * discounts_.back();
+            else
+                values[p] = survival_[p] * value + rebate_ * knockedRebate_[p];
+        }
+    }
+
+
     template <class RNG, class S>
     inline MakeMCBarrierEngine_2<RNG, S>::MakeMCBarrierEngine_2(
         ext::shared_ptr<GeneralizedBlackScholesProcess> process)
@@ -297,7 +855,72 @@ namespace QuantLib {
     template <class RNG, class S>
     inline MakeMCBarrierEngine_2<RNG, S>&
         MakeMCBarrierEngine_2<RNG, S>::withConstantParameters(bool constantParameters) {
-        constantParameters_ = constantParameters;
+        options_.constantParameters = constantParameters;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCBarrierEngine_2<RNG, S>&
+        MakeMCBarrierEngine_2<RNG, S>::withThreads(Size n) {
+        QL_REQUIRE(n > 0, "at least one thread required");
+        options_.threads = n;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCBarrierEngine_2<RNG, S>&
+        MakeMCBarrierEngine_2<RNG, S>::withBatchSize(Size n) {
+        options_.batchSize = n;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCBarrierEngine_2<RNG, S>&
+        MakeMCBarrierEngine_2<RNG, S>::withScrambles(Size n) {
+        QL_REQUIRE(n > 1, "at least two scrambles required");
+        options_.scrambles = n;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCBarrierEngine_2<RNG, S>&
+        MakeMCBarrierEngine_2<RNG, S>::withPiecewiseConstantParameters(bool b) {
+        options_.piecewiseParameters = b;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCBarrierEngine_2<RNG, S>&
+        MakeMCBarrierEngine_2<RNG, S>::withScenarios(std::vector<MarketScenario> scenarios) {
+        options_.scenarios = std::move(scenarios);
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCBarrierEngine_2<RNG, S>&
+        MakeMCBarrierEngine_2<RNG, S>::withMomentMatching(bool b) {
+        options_.batchSampling.momentMatching = b;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCBarrierEngine_2<RNG, S>&
+        MakeMCBarrierEngine_2<RNG, S>::withStratification(Size strata) {
+        options_.batchSampling.strata = strata;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCBarrierEngine_2<RNG, S>&
+        MakeMCBarrierEngine_2<RNG, S>::withSinglePrecision(bool b) {
+        options_.singlePrecision = b;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCBarrierEngine_2<RNG, S>&
+        MakeMCBarrierEngine_2<RNG, S>::withMultilevel(Size levels) {
+        options_.levels = levels;
         return *this;
     }
 
@@ -308,6 +931,14 @@ namespace QuantLib {
             "number of steps not given");
         QL_REQUIRE(steps_ == Null<Size>() || stepsPerYear_ == Null<Size>(),
             "number of steps overspecified");
+        // chaque niveau grossier garde un noeud sur deux du niveau au-dessus
+        QL_REQUIRE(options_.levels == 0 || steps_ != Null<Size>(),
+            "multilevel simulation requires a fixed number of steps");
+        QL_REQUIRE(options_.levels == 0 ||
+                   steps_ % (Size(1) << (options_.levels - 1)) == 0,
+            steps_ << " steps cannot be coarsened over "
+            << options_.levels << " levels: a multiple of "
+            << (Size(1) << (options_.levels - 1)) << " is required");
         return ext::make_shared<MCBarrierEngine_2<RNG, S>>(process_,
                                                            steps_,
                                                            stepsPerYear_,
@@ -318,7 +949,7 @@ namespace QuantLib {
                                                            maxSamples_,
                                                            biased_,
                                                            seed_,
-                                                           constantParameters_);
+                                                           options_);
     }
 
 } // namespace QuantLib
@@ -2,55 +2,405 @@
 #define QL_MCCONSTANTPROCESSHELPER_HPP
 
 #include <ql/processes/blackscholesprocess.hpp>
-#include <ql/methods/montecarlo/mctraits.hpp>           // pour SingleVariate
 #include <ql/methods/montecarlo/pathgenerator.hpp>      // PathGenerator
 #include <ql/payoff.hpp>
+#include <ql/timegrid.hpp>
+#include <utility>
+#include <vector>
 #include "constantblackscholesprocess.hpp"
+#include "piecewiseconstantblackscholesprocess.hpp"
+#include "batchpathgenerator.hpp"
+#include "lognormalpathgenerator.hpp"
+#include "mcgreeks.hpp"
+#include "mcpathmodel.hpp"
+#include "mcrandomizedqmc.hpp"
+#include "mcscenarios.hpp"
+#include "myconstutil.hpp"
 
 namespace QuantLib {
 
+    //! options des moteurs _2, remplies par les with* des factories
+    /*! Chaque moteur refuse celles qu'il n'implémente pas (voir son
+        constructeur) ; les incompatibilités communes sont vérifiées par
+        ConstantProcessEngineMixin.
+    */
+    struct McEngineOptions {
+        // process constant extrait à maturité
+        bool constantParameters = false;
+        // process constant sur chaque pas de la grille
+        bool piecewiseParameters = false;
+        Size threads = 1;
+        // blocs de batchSize chemins (0 : chemin par chemin)
+        Size batchSize = 0;
+        // brouillages indépendants en QMC randomisé
+        Size scrambles = 16;
+        // moment matching / stratification des blocs (batchSize > 0)
+        BatchSampling batchSampling;
+        // chemins des blocs en float (batchSize > 0)
+        bool singlePrecision = false;
+        // delta, gamma et vega sur les mêmes chemins que le prix
+        bool greeks = false;
+        // scénarios réévalués sur les mêmes tirages que le prix
+        std::vector<MarketScenario> scenarios;
+        // MLMC à levels niveaux, barrière (0 : pas de MLMC)
+        Size levels = 0;
+        // spot terminal tiré directement (européenne)
+        bool terminalSampling = false;
+        // variable de contrôle géométrique (asiatique)
+        bool controlVariate = false;
+    };
+
     //------------------------------------------------------------------------
-    // buildConstantBSPathGen<RNG> :
-    //   - prend un GeneralizedBlackScholesProcess
-    //   - ajoute un "eps" à la maturité
-    //   - crée un ConstantBlackScholesProcess
-    //   - retourne un PathGenerator< SingleVariate<...> > (type public)
+    // ConstantProcessEngineMixin<Engine, RNG> :
+    //   - classe de base (CRTP) commune aux moteurs _2
+    //   - choisit entre process constant, constant par intervalle et
+    //     process des courbes selon les options du moteur
+    //   - garde le cache des process extraits (ConstantProcessCache)
+    //   - construit les générateurs de chemins (PathGenerator, par blocs,
+    //     log-normal inliné) avec la graine dérivée de chaque thread
+    //   - lance les modèles (simulate) avec les réglages du moteur, et les
+    //     branches communes : chemins, chemins log-normaux, grecques et
+    //     scénarios ; chaque modèle a son générateur, les pricers passés
+    //     tels quels sont sans état et partagés par les threads, ceux des
+    //     fabriques (makePricer) sont construits par modèle
+    //   - garde les options du moteur (McEngineOptions) et vérifie à la
+    //     construction celles qui s'excluent quel que soit le moteur
+    //
+    // Le moteur la déclare amie et fournit :
+    //   process_, arguments_.payoff, timeGrid(), brownianBridge_, seed_,
+    //   antitheticVariate_, requiredSamples_, requiredTolerance_,
+    //   maxSamples_, samplingReport_ et le typedef stats_type
     //------------------------------------------------------------------------
-    template <class RNG>
-    ext::shared_ptr<
-        PathGenerator< SingleVariate<typename RNG::rsg_type::sample_type> >
-    >
-    buildConstantBSPathGen(
-        const ext::shared_ptr<GeneralizedBlackScholesProcess>& process,
-        const ext::shared_ptr<StrikedTypePayoff>& payoffStriked,
-        const TimeGrid& timeGrid,
-        typename RNG::rsg_type& generator,
-        bool brownianBridge,
-        Real eps = 1.0e-2
-    ) {
-        // 1) Vérifie qu'on a un process & payoff valides
-        QL_REQUIRE(process, "Invalid BS process");
-        QL_REQUIRE(payoffStriked, "Payoff is not a StrikedTypePayoff");
-
-        // 2) Extraction du temps + epsilon
-        Time time_of_extraction = timeGrid.back() + eps;
-
-        // 3) Paramètres (spot, strike, r, q, vol)
-        Real strike        = payoffStriked->strike();
-        Rate rRiskFree     = process->riskFreeRate()->zeroRate(time_of_extraction, Continuous);
-        Rate rDividend     = process->dividendYield()->zeroRate(time_of_extraction, Continuous);
-        Volatility vol     = process->blackVolatility()->blackVol(time_of_extraction, strike);
-        Real x0            = process->x0();
-
-        // 4) Construit un ConstantBlackScholesProcess
-        ext::shared_ptr<ConstantBlackScholesProcess> cstProcess(
-            new ConstantBlackScholesProcess(x0, rDividend, rRiskFree, vol)
-        );
-
-        // 5) Retourne un PathGenerator< SingleVariate<...> >
-        return ext::make_shared<
-            PathGenerator< SingleVariate<typename RNG::rsg_type::sample_type> >
-        >(cstProcess, timeGrid, generator, brownianBridge);
+    template <class Engine, class RNG>
+    class ConstantProcessEngineMixin {
+      public:
+        typedef PathGenerator<typename RNG::rsg_type> path_generator_type;
+        typedef ConstantBSBatchPathGenerator<typename RNG::rsg_type>
+            batch_path_generator_type;
+        typedef typename SingleVariate<RNG>::path_pricer_type path_pricer_type;
+
+      protected:
+        explicit ConstantProcessEngineMixin(McEngineOptions options);
+
+        //! process constant extrait à maturité (fin de la grille), du cache
+        ext::shared_ptr<ConstantBlackScholesProcess> constantProcess() const;
+        //! process constant sur chaque pas de la grille, du cache
+        ext::shared_ptr<PiecewiseConstantBlackScholesProcess> piecewiseProcess() const;
+
+        //! générateur de PathGenerator selon le mode du moteur
+        /*! Process constant, constant par intervalle ou process des
+            courbes ; le process par intervalle est copié quand il y a
+            plusieurs threads (intervalle courant mutable).
+        */
+        ext::shared_ptr<path_generator_type> makePathGenerator(BigNatural seed) const;
+        //! blocs de batchSize chemins (process constant uniquement),
+        //! tirés selon batchSampling, en float si singlePrecision
+        ext::shared_ptr<batch_path_generator_type> makeBatchPathGenerator(BigNatural seed) const;
+        //! chemins log-normaux, pas du process lus une fois (voir
+        //! LogNormalPathGenerator) ; pas de copie du process par thread
+        template <class Process>
+        ext::shared_ptr<LogNormalPathGenerator<typename RNG::rsg_type, Process> >
+        makeLogNormalPathGenerator(const Process& process,
+                                   const TimeGrid& grid,
+                                   BigNatural seed) const {
+            return ext::make_shared<
+                LogNormalPathGenerator<typename RNG::rsg_type, Process> >(
+                    process, grid,
+                    RNG::make_sequence_generator(grid.size() - 1, seed),
+                    engine().brownianBridge_);
+        }
+
+        //! simulateModels avec les threads, brouillages, tirages et
+        //! tolérance du moteur ; le rapport va dans samplingReport_
+        template <class ModelFactory>
+        std::pair<Real, Real> simulate(const ModelFactory& makeModel) const;
+
+        //! chemin par chemin (PathMonteCarloModel) sur makePathGenerator(),
+        //! makePricer(i) étant le pricer du i-ème modèle
+        template <class PricerFactory>
+        std::pair<Real, Real> simulatePaths(
+                const PricerFactory& makePricer,
+                const ext::shared_ptr<path_pricer_type>& controlPricer =
+                    ext::shared_ptr<path_pricer_type>(),
+                Real controlValue = 0.0) const;
+        //! idem, pas de Process résolus à la compilation
+        template <class Process, class PricerFactory>
+        std::pair<Real, Real> simulateLogNormalPaths(
+                const ext::shared_ptr<Process>& process,
+                const PricerFactory& makePricer,
+                const ext::shared_ptr<path_pricer_type>& controlPricer =
+                    ext::shared_ptr<path_pricer_type>(),
+                Real controlValue = 0.0) const;
+        //! chemins log-normaux du process constant, pricés avec leurs
+        //! grecques (voir GreeksMonteCarloModel)
+        std::pair<Real, Real> simulateWithGreeks(
+                const ext::shared_ptr<GreekPathPricer>& pricer,
+                const ext::shared_ptr<path_pricer_type>& controlPricer =
+                    ext::shared_ptr<path_pricer_type>(),
+                Real controlValue = 0.0) const;
+        //! prix de base et scénarios sur les mêmes normales ;
+        //! makePricer(scenario, process) price un scénario sur son
+        //! process choqué (le scénario 0 est le marché de base)
+        template <class PricerFactory>
+        std::pair<Real, Real> simulateScenarios(const PricerFactory& makePricer) const;
+        //! grecques et scénarios du dernier calcul, s'ils sont demandés
+        template <class Results>
+        void addGreekAndScenarioResults(Results& results) const;
+
+        const McEngineOptions options_;
+        // process constants déjà extraits du process du moteur
+        mutable ConstantProcessCache constantProcessCache_;
+
+      private:
+        const Engine& engine() const {
+            return static_cast<const Engine&>(*this);
+        }
+        ext::shared_ptr<GeneralizedBlackScholesProcess> blackScholesProcess() const;
+        Real strike() const;
+    };
+
+
+    // template definitions
+
+    template <class Engine, class RNG>
+    inline ConstantProcessEngineMixin<Engine, RNG>::ConstantProcessEngineMixin(
+                                                     McEngineOptions options)
+    : options_(std::move(options)) {
+        const McEngineOptions& o = options_;
+        // chemin par chemin : ni blocs, ni tirage du seul spot terminal
+        bool pathByPath = o.batchSize == 0 && !o.terminalSampling;
+        QL_REQUIRE(o.threads > 0, "at least one thread required");
+        checkThreadsForGenerator<RNG>(o.threads);
+        QL_REQUIRE(!(o.piecewiseParameters && o.constantParameters),
+                   "constant and piecewise-constant parameters are exclusive");
+        QL_REQUIRE(o.batchSize == 0 || o.constantParameters,
+                   "batch simulation requires constant parameters");
+        QL_REQUIRE(!o.terminalSampling || o.constantParameters,
+                   "terminal sampling requires constant parameters");
+        QL_REQUIRE(!o.greeks || (o.constantParameters && pathByPath),
+                   "greeks require constant parameters, path by path");
+        QL_REQUIRE(o.scenarios.empty() ||
+                   (o.constantParameters && pathByPath &&
+                    !o.greeks && !o.controlVariate),
+                   "scenarios require constant parameters, path by path, "
+                   "without greeks or control variate");
+        checkBatchSampling(o.batchSampling, o.batchSize);
+        QL_REQUIRE(o.batchSampling.plain() || !o.terminalSampling,
+                   "moment matching and stratification not available "
+                   "with terminal sampling");
+        QL_REQUIRE(!o.singlePrecision || (o.batchSize > 0 && !o.terminalSampling),
+                   "single precision requires batch simulation");
+        QL_REQUIRE(o.levels == 0 ||
+                   (pathByPath && o.scenarios.empty() && !o.greeks &&
+                    !o.controlVariate && !o.piecewiseParameters),
+                   "multilevel simulation requires path-by-path simulation, "
+                   "without scenarios, greeks, control variate or "
+                   "piecewise-constant parameters");
+        QL_REQUIRE(o.levels == 0 || !is_low_discrepancy<RNG>::value,
+                   "multilevel simulation requires pseudo-random numbers");
+    }
+
+    template <class Engine, class RNG>
+    inline ext::shared_ptr<GeneralizedBlackScholesProcess>
+    ConstantProcessEngineMixin<Engine, RNG>::blackScholesProcess() const {
+        auto BS_process = ext::dynamic_pointer_cast<GeneralizedBlackScholesProcess>(
+            engine().process_);
+        QL_REQUIRE(BS_process, "Black-Scholes process required");
+        return BS_process;
+    }
+
+    template <class Engine, class RNG>
+    inline Real ConstantProcessEngineMixin<Engine, RNG>::strike() const {
+        auto payoff = ext::dynamic_pointer_cast<StrikedTypePayoff>(
+            engine().arguments_.payoff);
+        QL_REQUIRE(payoff, "Payoff is not a StrikedTypePayoff");
+        return payoff->strike();
+    }
+
+    template <class Engine, class RNG>
+    inline ext::shared_ptr<ConstantBlackScholesProcess>
+    ConstantProcessEngineMixin<Engine, RNG>::constantProcess() const {
+        return constantProcessCache_.get(blackScholesProcess(),
+                                         engine().timeGrid().back(),
+                                         strike());
+    }
+
+    template <class Engine, class RNG>
+    inline ext::shared_ptr<PiecewiseConstantBlackScholesProcess>
+    ConstantProcessEngineMixin<Engine, RNG>::piecewiseProcess() const {
+        return constantProcessCache_.getPiecewise(blackScholesProcess(),
+                                                  engine().timeGrid(),
+                                                  strike());
+    }
+
+    template <class Engine, class RNG>
+    inline ext::shared_ptr<
+        typename ConstantProcessEngineMixin<Engine, RNG>::path_generator_type>
+    ConstantProcessEngineMixin<Engine, RNG>::makePathGenerator(BigNatural seed) const {
+        const Engine& e = engine();
+        TimeGrid grid = e.timeGrid();
+        typename RNG::rsg_type generator =
+            RNG::make_sequence_generator(e.process_->factors() * (grid.size() - 1),
+                                         seed);
+
+        if (options_.constantParameters) {
+            // PAS DE + eps ; process sans état : le même pour tous les threads
+            return ext::make_shared<path_generator_type>(
+                constantProcess(), grid, generator, e.brownianBridge_);
+        } else if (options_.piecewiseParameters) {
+            // une copie par thread (intervalle courant mutable)
+            auto pw_BS_process = piecewiseProcess();
+            if (options_.threads > 1)
+                pw_BS_process =
+                    ext::make_shared<PiecewiseConstantBlackScholesProcess>(*pw_BS_process);
+            return ext::make_shared<path_generator_type>(
+                pw_BS_process, grid, generator, e.brownianBridge_);
+        } else {
+            return ext::make_shared<path_generator_type>(
+                e.process_, grid, generator, e.brownianBridge_);
+        }
+    }
+
+    template <class Engine, class RNG>
+    inline ext::shared_ptr<
+        typename ConstantProcessEngineMixin<Engine, RNG>::batch_path_generator_type>
+    ConstantProcessEngineMixin<Engine, RNG>::makeBatchPathGenerator(BigNatural seed) const {
+        const Engine& e = engine();
+        QL_REQUIRE(options_.constantParameters,
+                   "batch simulation requires constant parameters");
+        TimeGrid grid = e.timeGrid();
+        typename RNG::rsg_type generator =
+            RNG::make_sequence_generator(grid.size() - 1, seed);
+        return ext::make_shared<batch_path_generator_type>(
+            *constantProcess(), grid, generator, e.brownianBridge_,
+            options_.batchSize, options_.batchSampling,
+            options_.singlePrecision);
+    }
+
+    template <class Engine, class RNG>
+    template <class ModelFactory>
+    inline std::pair<Real, Real>
+    ConstantProcessEngineMixin<Engine, RNG>::simulate(
+                                        const ModelFactory& makeModel) const {
+        const Engine& e = engine();
+        return simulateModels<RNG>(options_.threads, options_.scrambles,
+                                   makeModel,
+                                   e.requiredTolerance_,
+                                   e.requiredSamples_,
+                                   e.maxSamples_,
+                                   &e.samplingReport_);
+    }
+
+    template <class Engine, class RNG>
+    template <class PricerFactory>
+    inline std::pair<Real, Real>
+    ConstantProcessEngineMixin<Engine, RNG>::simulatePaths(
+                const PricerFactory& makePricer,
+                const ext::shared_ptr<path_pricer_type>& controlPricer,
+                Real controlValue) const {
+        typedef typename Engine::stats_type S;
+        const Engine& e = engine();
+        auto makeModel = [&](Size i) {
+            return ext::make_shared<PathMonteCarloModel<RNG,S> >(
+                makePathGenerator(deriveSeed(e.seed_, i)),
+                makePricer(i), e.antitheticVariate_,
+                controlPricer, controlValue);
+        };
+        return simulate(makeModel);
+    }
+
+    template <class Engine, class RNG>
+    template <class Process, class PricerFactory>
+    inline std::pair<Real, Real>
+    ConstantProcessEngineMixin<Engine, RNG>::simulateLogNormalPaths(
+                const ext::shared_ptr<Process>& process,
+                const PricerFactory& makePricer,
+                const ext::shared_ptr<path_pricer_type>& controlPricer,
+                Real controlValue) const {
+        typedef typename Engine::stats_type S;
+        typedef LogNormalPathGenerator<typename RNG::rsg_type, Process>
+            generator_type;
+        const Engine& e = engine();
+        TimeGrid grid = e.timeGrid();
+        auto makeModel = [&](Size i) {
+            return ext::make_shared<PathMonteCarloModel<RNG,S,generator_type> >(
+                makeLogNormalPathGenerator(*process, grid,
+                                           deriveSeed(e.seed_, i)),
+                makePricer(i), e.antitheticVariate_,
+                controlPricer, controlValue);
+        };
+        return simulate(makeModel);
+    }
+
+    template <class Engine, class RNG>
+    inline std::pair<Real, Real>
+    ConstantProcessEngineMixin<Engine, RNG>::simulateWithGreeks(
+                const ext::shared_ptr<GreekPathPricer>& pricer,
+                const ext::shared_ptr<path_pricer_type>& controlPricer,
+                Real controlValue) const {
+        typedef typename Engine::stats_type S;
+        typedef LogNormalPathGenerator<typename RNG::rsg_type,
+                                       ConstantBlackScholesProcess>
+            generator_type;
+        const Engine& e = engine();
+        auto process = constantProcess();
+        TimeGrid grid = e.timeGrid();
+        auto makeModel = [&](Size i) {
+            return ext::make_shared<GreeksMonteCarloModel<RNG,S,generator_type> >(
+                makeLogNormalPathGenerator(*process, grid,
+                                           deriveSeed(e.seed_, i)),
+                pricer, e.antitheticVariate_,
+                controlPricer, controlValue);
+        };
+        return simulate(makeModel);
+    }
+
+    template <class Engine, class RNG>
+    template <class PricerFactory>
+    inline std::pair<Real, Real>
+    ConstantProcessEngineMixin<Engine, RNG>::simulateScenarios(
+                                  const PricerFactory& makePricer) const {
+        typedef typename Engine::stats_type S;
+        const Engine& e = engine();
+        std::vector<MarketScenario> all(1);
+        all.insert(all.end(), options_.scenarios.begin(),
+                   options_.scenarios.end());
+        auto base = constantProcess();
+        std::vector<ext::shared_ptr<ConstantBlackScholesProcess> > processes;
+        std::vector<ext::shared_ptr<path_pricer_type> > pricers;
+        for (const auto& scenario : all) {
+            processes.push_back(bumpedProcess(*base, scenario));
+            pricers.push_back(makePricer(scenario, *processes.back()));
+        }
+        TimeGrid grid = e.timeGrid();
+        auto makeModel = [&](Size i) {
+            return ext::make_shared<ScenarioMonteCarloModel<RNG,S> >(
+                RNG::make_sequence_generator(grid.size() - 1,
+                                             deriveSeed(e.seed_, i)),
+                grid, e.brownianBridge_, e.antitheticVariate_,
+                processes, pricers);
+        };
+        return simulate(makeModel);
+    }
+
+    template <class Engine, class RNG>
+    template <class Results>
+    inline void ConstantProcessEngineMixin<Engine, RNG>::addGreekAndScenarioResults(
+                                                   Results& results) const {
+        const SamplingReport& report = engine().samplingReport_;
+        if (options_.greeks) {
+            results.delta = report.greeks.delta.mean();
+            results.gamma = report.greeks.gamma.mean();
+            results.vega = report.greeks.vega.mean();
+            if (RNG::allowsErrorEstimate)
+                report.addGreekErrorsTo(results.additionalResults);
+        }
+        if (!options_.scenarios.empty())
+            addScenarioResults(report.scenarios,
+                               RNG::allowsErrorEstimate ?
+                                   report.scenarioErrorEstimates() :
+                                   std::vector<Real>(),
+                               results.additionalResults);
     }
 
 } // namespace QuantLib
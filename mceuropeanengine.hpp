@@ -10,6 +10,16 @@
 
 // On inclut NOTRE utilitaire factorisé (sans eps)
 #include "myconstutil.hpp"
+#include "mcsamplingloop.hpp"
+#include "mcparallel.hpp"
+#include "batchpathgenerator.hpp"
+#include "mcrandomizedqmc.hpp"
+#include "philoxrng.hpp"
+#include "mcpathmodel.hpp"
+#include "lognormalpathgenerator.hpp"
+#include "mcgreeks.hpp"
+#include "mcscenarios.hpp"
+#include "mcconstantprocesshelper.hpp"
 
 namespace QuantLib {
 
@@ -17,13 +27,18 @@ namespace QuantLib {
     // EuropeanOption Monte Carlo (nouvelle version) sans offset
     // ------------------------------------------------------------------------
     template <class RNG = PseudoRandom, class S = Statistics>
-    class MCEuropeanEngine_2 : public MCVanillaEngine<SingleVariate,RNG,S> {
+    class MCEuropeanEngine_2 : public MCVanillaEngine<SingleVariate,RNG,S>,
+                               public ConstantProcessEngineMixin<MCEuropeanEngine_2<RNG,S>, RNG> {
       public:
         typedef typename MCVanillaEngine<SingleVariate, RNG, S>::path_generator_type path_generator_type;
         typedef typename MCVanillaEngine<SingleVariate, RNG, S>::path_pricer_type    path_pricer_type;
         typedef typename MCVanillaEngine<SingleVariate, RNG, S>::stats_type          stats_type;
 
         // constructor
+        /*! The simulation mode (constant parameters, threads, batches,
+            greeks, scenarios...) is given by the options, usually filled
+            by MakeMCEuropeanEngine_2.
+        */
         MCEuropeanEngine_2(
              const boost::shared_ptr<GeneralizedBlackScholesProcess>& process,
              Size timeSteps,
@@ -34,13 +49,49 @@ namespace QuantLib {
              Real requiredTolerance,
              Size maxSamples,
              BigNatural seed,
-             bool ConstantParameters);
+             McEngineOptions options = McEngineOptions());
+
+        void calculate() const override;
+
+        //! heap allocations made while sampling in the last calculation
+        /*! Paths are drawn into the buffers owned by the path generators
+            and the pricers do not allocate, so this is zero when the
+            number of samples is fixed.  Only counted in programs built
+            with QL_MC_COUNT_HEAP_ALLOCATIONS (see mcallocationcounter.hpp).
+        */
+        Size sampleAllocations() const {
+            return samplingReport_.sampleAllocations;
+        }
+
+        //! samples used and sampling time of the last calculation
+        /*! With a tolerance, elapsedTime is the time to tolerance. */
+        const SamplingReport& samplingReport() const {
+            return samplingReport_;
+        }
 
       private:
-        bool ConstantParameters;
+        typedef ConstantProcessEngineMixin<MCEuropeanEngine_2, RNG> process_mixin;
+        friend class ConstantProcessEngineMixin<MCEuropeanEngine_2, RNG>;
+        using process_mixin::constantProcess;
+        using process_mixin::piecewiseProcess;
+        using process_mixin::makePathGenerator;
+        using process_mixin::makeBatchPathGenerator;
+        using process_mixin::simulate;
+        using process_mixin::simulatePaths;
+        using process_mixin::simulateLogNormalPaths;
+        using process_mixin::simulateWithGreeks;
+        using process_mixin::simulateScenarios;
+        using process_mixin::addGreekAndScenarioResults;
+        using process_mixin::constantProcessCache_;
+        using process_mixin::options_;
+
+        mutable SamplingReport samplingReport_;
 
         // Override the path generator
         ext::shared_ptr<path_generator_type> pathGenerator() const override;
+        // the plain payoff and the discount factor to maturity
+        ext::shared_ptr<PlainVanillaPayoff> plainPayoff() const;
+        DiscountFactor maturityDiscount() const;
 
       protected:
         boost::shared_ptr<path_pricer_type> pathPricer() const override;
@@ -62,6 +113,26 @@ namespace QuantLib {
         MakeMCEuropeanEngine_2& withSeed(BigNatural seed);
         MakeMCEuropeanEngine_2& withAntitheticVariate(bool b = true);
         MakeMCEuropeanEngine_2& withConstantParameters(bool b = true);
+        //! draw the terminal spot directly (requires constant parameters)
+        MakeMCEuropeanEngine_2& withTerminalSampling(bool b = true);
+        //! split the samples across n threads
+        MakeMCEuropeanEngine_2& withThreads(Size n);
+        //! simulate blocks of n paths at once (requires constant parameters)
+        MakeMCEuropeanEngine_2& withBatchSize(Size n);
+        //! independent scrambles for randomized QMC (ScrambledSobol)
+        MakeMCEuropeanEngine_2& withScrambles(Size n);
+        //! rates and volatility constant on each step of the grid
+        MakeMCEuropeanEngine_2& withPiecewiseConstantParameters(bool b = true);
+        //! delta, gamma and vega in the same run (requires constant parameters)
+        MakeMCEuropeanEngine_2& withGreeks(bool b = true);
+        //! bumped scenarios priced on the same paths (requires constant parameters)
+        MakeMCEuropeanEngine_2& withScenarios(std::vector<MarketScenario> scenarios);
+        //! moment-matched normals in each block (requires a batch size)
+        MakeMCEuropeanEngine_2& withMomentMatching(bool b = true);
+        //! terminal Brownian value stratified in n strata (requires a batch size)
+        MakeMCEuropeanEngine_2& withStratification(Size strata);
+        //! paths of the blocks built in float (requires a batch size)
+        MakeMCEuropeanEngine_2& withSinglePrecision(bool b = true);
         // conversion to pricing engine
         operator boost::shared_ptr<PricingEngine>() const;
       private:
@@ -71,7 +142,7 @@ namespace QuantLib {
         Real tolerance_;
         bool brownianBridge_;
         BigNatural seed_;
-        bool ConstantParameters;
+        McEngineOptions options_;
     };
 
     class EuropeanPathPricer_2 : public PathPricer<Path> {
@@ -85,6 +156,67 @@ namespace QuantLib {
         DiscountFactor discount_;
     };
 
+    class EuropeanBatchPathPricer : public BatchPathPricer {
+      public:
+        EuropeanBatchPathPricer(Option::Type type,
+                                Real strike,
+                                DiscountFactor discount);
+        void operator()(const PathBlock& paths, Real* values) const override;
+      private:
+        PlainVanillaPayoff payoff_;
+        DiscountFactor discount_;
+    };
+
+    //! European path pricer with pathwise delta and vega and LR gamma
+    /*! For paths of the given constant process; gamma uses the density
+        of the terminal spot.
+    */
+    class EuropeanGreekPathPricer : public GreekPathPricer {
+      public:
+        EuropeanGreekPathPricer(Option::Type type,
+                                Real strike,
+                                DiscountFactor discount,
+                                const ConstantBlackScholesProcess& process);
+        PathGreeks greeks(const Path& path) const override;
+      private:
+        Real sign_, strike_;
+        DiscountFactor discount_;
+        Real logDrift_;
+        Volatility volatility_;
+    };
+
+    //! Terminal-only sampling of a European payoff
+    /*! With constant parameters the terminal spot is exactly log-normal:
+        each sample draws a single Gaussian and prices the payoff on
+        x0*exp((r-q-sigma^2/2)T + sigma*sqrt(T)*w), without building
+        a time grid or a Path.  Provides the addSamples() and
+        sampleAccumulator() interface used by simulateSamples().
+    */
+    template <class RNG, class S>
+    class EuropeanTerminalModel {
+      public:
+        typedef S stats_type;
+
+        EuropeanTerminalModel(const ConstantBlackScholesProcess& process,
+                              Time maturity,
+                              Option::Type type,
+                              Real strike,
+                              DiscountFactor discount,
+                              bool antitheticVariate,
+                              BigNatural seed);
+        void addSamples(Size samples);
+        const S& sampleAccumulator() const { return sampleAccumulator_; }
+        const McProfile& profile() const { return profile_; }
+      private:
+        typename RNG::rsg_type generator_;
+        Real x0_, drift_, stdDev_;
+        PlainVanillaPayoff payoff_;
+        DiscountFactor discount_;
+        bool antitheticVariate_;
+        S sampleAccumulator_;
+        McProfile profile_;
+    };
+
     // ------------------------------------------------------------------------
     //    MCEuropeanEngine_2 Implementation
     // ------------------------------------------------------------------------
@@ -101,7 +233,7 @@ namespace QuantLib {
              Real requiredTolerance,
              Size maxSamples,
              BigNatural seed,
-             bool ConstantParameters)
+             McEngineOptions options)
     : MCVanillaEngine<SingleVariate,RNG,S>(process,
                                            timeSteps,
                                            timeStepsPerYear,
@@ -112,52 +244,116 @@ namespace QuantLib {
                                            requiredTolerance,
                                            maxSamples,
                                            seed),
-      ConstantParameters(ConstantParameters)
+      process_mixin(std::move(options))
     {
+        // les incompatibilités communes sont vérifiées par le mixin
+        QL_REQUIRE(!options_.controlVariate,
+                   "control variate not available for European options");
+        QL_REQUIRE(options_.levels == 0,
+                   "multilevel simulation not available for European options");
     }
 
     template <class RNG, class S>
-    inline
-    ext::shared_ptr<typename MCEuropeanEngine_2<RNG,S>::path_generator_type>
-    MCEuropeanEngine_2<RNG,S>::pathGenerator() const {
-
-        Size dimensions = this->process_->factors();
-        TimeGrid grid   = this->timeGrid();
-
-        typename RNG::rsg_type generator =
-            RNG::make_sequence_generator(dimensions * (grid.size()-1),
-                                         this->seed_);
-
-        if (this->ConstantParameters == true) {
-            // FACTORISATION : On appelle makeConstantProcess(...)
-            ext::shared_ptr<GeneralizedBlackScholesProcess> BS_process =
-                ext::dynamic_pointer_cast<GeneralizedBlackScholesProcess>(
-                    this->process_
+    inline void MCEuropeanEngine_2<RNG,S>::calculate() const {
+        // (valeur, erreur) ; en QMC randomisé, un modèle par brouillage.
+        // Le cas série passe aussi par simulateModels (même boucle que
+        // McSimulation) pour compter les allocations.
+        QL_MC_PROFILE_ONLY(McCalculationProfile calculationProfile);
+        QL_MC_PROFILE_ONLY(constantProcessCache_.resetProfile());
+        // un pricer par modèle
+        auto makePricer = [this](Size) { return this->pathPricer(); };
+        std::pair<Real, Real> result;
+        if (options_.terminalSampling) {
+            ext::shared_ptr<PlainVanillaPayoff> payoff = plainPayoff();
+            Time maturity = this->timeGrid().back();
+            auto cst_BS_process = constantProcess();
+            DiscountFactor disc = maturityDiscount();
+
+            auto makeModel = [&](Size i) {
+                return ext::make_shared<EuropeanTerminalModel<RNG,S> >(
+                    *cst_BS_process, maturity,
+                    payoff->optionType(), payoff->strike(), disc,
+                    this->antitheticVariate_, deriveSeed(this->seed_, i)
                 );
+            };
+            result = simulate(makeModel);
+        } else if (options_.batchSize > 0) {
+            ext::shared_ptr<PlainVanillaPayoff> payoff = plainPayoff();
+            ext::shared_ptr<BatchPathPricer> batchPricer =
+                ext::make_shared<EuropeanBatchPathPricer>(
+                    payoff->optionType(), payoff->strike(),
+                    maturityDiscount()
+                );
+            auto makeModel = [&](Size i) {
+                return ext::make_shared<BatchMonteCarloModel<RNG,S> >(
+                    makeBatchPathGenerator(deriveSeed(this->seed_, i)),
+                    batchPricer, this->antitheticVariate_
+                );
+            };
+            result = simulate(makeModel);
+        } else if (options_.constantParameters && !options_.scenarios.empty()) {
+            // le choc de taux s'applique aussi à l'actualisation
+            ext::shared_ptr<PlainVanillaPayoff> payoff = plainPayoff();
+            DiscountFactor disc = maturityDiscount();
+            Time maturity = this->timeGrid().back();
+            result = simulateScenarios(
+                [&](const MarketScenario& scenario,
+                    const ConstantBlackScholesProcess&)
+                        -> ext::shared_ptr<path_pricer_type> {
+                    return ext::make_shared<EuropeanPathPricer_2>(
+                        payoff->optionType(), payoff->strike(),
+                        disc * std::exp(-scenario.rateShift * maturity));
+                });
+        } else if (options_.constantParameters && options_.greeks) {
+            ext::shared_ptr<PlainVanillaPayoff> payoff = plainPayoff();
+            result = simulateWithGreeks(
+                ext::make_shared<EuropeanGreekPathPricer>(
+                    payoff->optionType(), payoff->strike(),
+                    maturityDiscount(), *constantProcess()));
+        } else if (options_.constantParameters) {
+            result = simulateLogNormalPaths(constantProcess(), makePricer);
+        } else if (options_.piecewiseParameters) {
+            result = simulateLogNormalPaths(piecewiseProcess(), makePricer);
+        } else {
+            result = simulatePaths(makePricer);
+        }
 
-            Time time_of_extraction = grid.back();
+        this->results_.value = result.first;
+        if (RNG::allowsErrorEstimate)
+            this->results_.errorEstimate = result.second;
+        addGreekAndScenarioResults(this->results_);
+        QL_MC_PROFILE_ONLY(calculationProfile.finish(
+            samplingReport_.profile, constantProcessCache_.profile(),
+            samplingReport_.elapsedTime,
+            this->results_.additionalResults));
+    }
 
-            double strike = ext::dynamic_pointer_cast<StrikedTypePayoff>(
+    template <class RNG, class S>
+    inline ext::shared_ptr<PlainVanillaPayoff>
+    MCEuropeanEngine_2<RNG,S>::plainPayoff() const {
+        ext::shared_ptr<PlainVanillaPayoff> payoff =
+            ext::dynamic_pointer_cast<PlainVanillaPayoff>(
                 this->arguments_.payoff
-            )->strike();
-
-            auto cst_BS_process = makeConstantProcess(
-                BS_process,
-                time_of_extraction,
-                strike
-                // plus de eps
             );
+        QL_REQUIRE(payoff, "non-plain payoff given");
+        return payoff;
+    }
 
-            return ext::make_shared<path_generator_type>(
-                cst_BS_process, grid, generator, this->brownianBridge_
+    template <class RNG, class S>
+    inline DiscountFactor MCEuropeanEngine_2<RNG,S>::maturityDiscount() const {
+        ext::shared_ptr<GeneralizedBlackScholesProcess> BS_process =
+            ext::dynamic_pointer_cast<GeneralizedBlackScholesProcess>(
+                this->process_
             );
+        QL_REQUIRE(BS_process, "Black-Scholes process required");
+        return BS_process->riskFreeRate()->discount(this->timeGrid().back());
+    }
 
-        } else {
-            // Branche "non constant"
-            return ext::make_shared<path_generator_type>(
-                this->process_, grid, generator, this->brownianBridge_
-            );
-        }
+    template <class RNG, class S>
+    inline
+    ext::shared_ptr<typename MCEuropeanEngine_2<RNG,S>::path_generator_type>
+    MCEuropeanEngine_2<RNG,S>::pathGenerator() const {
+        return makePathGenerator(this->seed_);
     }
 
     template <class RNG, class S>
@@ -194,7 +390,9 @@ namespace QuantLib {
     : process_(process), antithetic_(false),
       steps_(Null<Size>()), stepsPerYear_(Null<Size>()),
       samples_(Null<Size>()), maxSamples_(Null<Size>()),
-      tolerance_(Null<Real>()), brownianBridge_(false), seed_(0), ConstantParameters(false)
+      tolerance_(Null<Real>()),
+      brownianBridge_(is_low_discrepancy<RNG>::value), // pont brownien par défaut en QMC
+      seed_(0)
     {
     }
 
@@ -264,7 +462,80 @@ namespace QuantLib {
     template <class RNG, class S>
     inline MakeMCEuropeanEngine_2<RNG,S>&
     MakeMCEuropeanEngine_2<RNG,S>::withConstantParameters(bool b) {
-        ConstantParameters = b;
+        options_.constantParameters = b;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCEuropeanEngine_2<RNG,S>&
+    MakeMCEuropeanEngine_2<RNG,S>::withTerminalSampling(bool b) {
+        options_.terminalSampling = b;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCEuropeanEngine_2<RNG,S>&
+    MakeMCEuropeanEngine_2<RNG,S>::withThreads(Size n) {
+        QL_REQUIRE(n > 0, "at least one thread required");
+        options_.threads = n;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCEuropeanEngine_2<RNG,S>&
+    MakeMCEuropeanEngine_2<RNG,S>::withBatchSize(Size n) {
+        options_.batchSize = n;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCEuropeanEngine_2<RNG,S>&
+    MakeMCEuropeanEngine_2<RNG,S>::withScrambles(Size n) {
+        QL_REQUIRE(n > 1, "at least two scrambles required");
+        options_.scrambles = n;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCEuropeanEngine_2<RNG,S>&
+    MakeMCEuropeanEngine_2<RNG,S>::withPiecewiseConstantParameters(bool b) {
+        options_.piecewiseParameters = b;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCEuropeanEngine_2<RNG,S>&
+    MakeMCEuropeanEngine_2<RNG,S>::withGreeks(bool b) {
+        options_.greeks = b;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCEuropeanEngine_2<RNG,S>&
+    MakeMCEuropeanEngine_2<RNG,S>::withScenarios(
+                                  std::vector<MarketScenario> scenarios) {
+        options_.scenarios = std::move(scenarios);
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCEuropeanEngine_2<RNG,S>&
+    MakeMCEuropeanEngine_2<RNG,S>::withMomentMatching(bool b) {
+        options_.batchSampling.momentMatching = b;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCEuropeanEngine_2<RNG,S>&
+    MakeMCEuropeanEngine_2<RNG,S>::withStratification(Size strata) {
+        options_.batchSampling.strata = strata;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MakeMCEuropeanEngine_2<RNG,S>&
+    MakeMCEuropeanEngine_2<RNG,S>::withSinglePrecision(bool b) {
+        options_.singlePrecision = b;
         return *this;
     }
 
@@ -284,7 +555,7 @@ namespace QuantLib {
                                       samples_, tolerance_,
                                       maxSamples_,
                                       seed_,
-                                      ConstantParameters));
+                                      options_));
     }
 
     inline EuropeanPathPricer_2::EuropeanPathPricer_2(Option::Type type,
@@ -300,6 +571,92 @@ namespace QuantLib {
         return payoff_(path.back()) * discount_;
     }
 
+    inline EuropeanBatchPathPricer::EuropeanBatchPathPricer(
+                                                      Option::Type type,
+                                                      Real strike,
+                                                      DiscountFactor discount)
+    : payoff_(type, strike), discount_(discount) {
+        QL_REQUIRE(strike>=0.0,
+                   "strike less than zero not allowed");
+    }
+
+    inline void EuropeanBatchPathPricer::operator()(const PathBlock& paths,
+                                                    Real* values) const {
+        const Real* last = paths.node(paths.length() - 1);
+        for (Size p = 0; p < paths.size(); ++p)
+            values[p] = payoff_(last[p]) * discount_;
+    }
+
+    inline EuropeanGreekPathPricer::EuropeanGreekPathPricer(
+                                    Option::Type type,
+                                    Real strike,
+                                    DiscountFactor discount,
+                                    const ConstantBlackScholesProcess& process)
+    : sign_(type == Option::Call ? 1.0 : -1.0), strike_(strike),
+      discount_(discount), logDrift_(process.logDrift()),
+      volatility_(process.volatility()) {
+        QL_REQUIRE(strike>=0.0,
+                   "strike less than zero not allowed");
+        QL_REQUIRE(volatility_ > 0.0, "positive volatility required for greeks");
+    }
+
+    inline PathGreeks EuropeanGreekPathPricer::greeks(const Path& path) const {
+        Size n = path.length();
+        QL_REQUIRE(n > 1, "the path cannot be empty");
+        Real x0 = path.front(), spot = path.back();
+        Time maturity = path.timeGrid().back() - path.timeGrid().front();
+        Real w = brownianMotionAt(path, n - 1, logDrift_, volatility_);
+        // discount * dPayoff/dS_T
+        Real slope = sign_ * (spot - strike_) > 0.0 ? sign_ * discount_ : 0.0;
+        PathGreeks greeks;
+        greeks.value = discount_ * std::max(sign_ * (spot - strike_), 0.0);
+        greeks.delta = slope * spot / x0;
+        greeks.vega = slope * spot * (w - volatility_ * maturity);
+        greeks.gamma = greeks.value * likelihoodRatioGammaWeight(
+            w / std::sqrt(maturity), x0, volatility_, maturity);
+        return greeks;
+    }
+
+    template <class RNG, class S>
+    inline EuropeanTerminalModel<RNG,S>::EuropeanTerminalModel(
+                                    const ConstantBlackScholesProcess& process,
+                                    Time maturity,
+                                    Option::Type type,
+                                    Real strike,
+                                    DiscountFactor discount,
+                                    bool antitheticVariate,
+                                    BigNatural seed)
+    : generator_(RNG::make_sequence_generator(1, seed)),
+      x0_(process.x0()),
+      drift_(process.logDrift() * maturity),
+      stdDev_(process.stdDeviation(0.0, process.x0(), maturity)),
+      payoff_(type, strike), discount_(discount),
+      antitheticVariate_(antitheticVariate) {}
+
+    template <class RNG, class S>
+    inline void EuropeanTerminalModel<RNG,S>::addSamples(Size samples) {
+        for (Size j = 0; j < samples; ++j) {
+            const typename RNG::rsg_type::sample_type* sample;
+            {
+                QL_MC_PROFILE_PHASE(profile_, RandomNumbers);
+                sample = &generator_.nextSequence();
+            }
+            QL_MC_PROFILE_ONLY(++profile_.randomDraws);
+            QL_MC_PROFILE_ONLY(profile_.paths += antitheticVariate_ ? 2 : 1);
+
+            // terminal spot and payoff in one go: timed as pricing
+            Real dw = sample->value[0], value;
+            {
+                QL_MC_PROFILE_PHASE(profile_, Pricing);
+                value = payoff_(x0_ * std::exp(drift_ + stdDev_ * dw));
+                if (antitheticVariate_)
+                    value = (value + payoff_(x0_ * std::exp(drift_ - stdDev_ * dw))) / 2.0;
+            }
+            QL_MC_PROFILE_PHASE(profile_, Accumulation);
+            sampleAccumulator_.add(discount_ * value, sample->weight);
+        }
+    }
+
 }
 
 #endif
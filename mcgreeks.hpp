@@ -0,0 +1,192 @@
+#ifndef QL_MCGREEKS_HPP
+#define QL_MCGREEKS_HPP
+
+#include <ql/methods/montecarlo/mctraits.hpp>
+#include <ql/methods/montecarlo/path.hpp>
+#include <ql/methods/montecarlo/pathpricer.hpp>
+#include <ql/pricingengine.hpp>
+#include <ql/shared_ptr.hpp>
+#include <cmath>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "mcprofiler.hpp"
+#include "streamingstatistics.hpp"
+
+namespace QuantLib {
+
+    //------------------------------------------------------------------------
+    // Greeks in the pricing run, for paths of ConstantBlackScholesProcess:
+    //   - delta and vega are pathwise: the derivative of the discounted
+    //     payoff along the path, S_i being homogeneous in x0 and
+    //     dS_i/dsigma = S_i (W_i - sigma t_i)
+    //   - gamma is a likelihood ratio: the payoff times the second score
+    //     of the density of one log-normal step with respect to x0
+    //   - the greeks of each sample go to a GreekStatistics held by the
+    //     model, which simulateModels() returns in the SamplingReport
+    //------------------------------------------------------------------------
+
+    //! discounted payoff of a path and its sensitivities
+    struct PathGreeks {
+        Real value = 0.0, delta = 0.0, gamma = 0.0, vega = 0.0;
+    };
+
+    //! Path pricer also returning the greeks of the path
+    class GreekPathPricer : public PathPricer<Path> {
+      public:
+        Real operator()(const Path& path) const override {
+            return greeks(path).value;
+        }
+        virtual PathGreeks greeks(const Path& path) const = 0;
+    };
+
+    //! Brownian motion W_i at the i-th node of a constant-parameter path
+    inline Real brownianMotionAt(const Path& path, Size i,
+                                 Real logDrift, Volatility volatility) {
+        Time t = path.timeGrid()[i] - path.timeGrid().front();
+        return (std::log(path[i] / path.front()) - logDrift * t) / volatility;
+    }
+
+    //! likelihood-ratio gamma weight of a log-normal step
+    /*! Second derivative of the density of ln S_t with respect to x0,
+        divided by the density; z is the standard normal of the step.
+    */
+    inline Real likelihoodRatioGammaWeight(Real z, Real x0,
+                                           Volatility volatility, Time dt) {
+        Real sigmaSqrtDt = volatility * std::sqrt(dt);
+        return ((z * z - 1.0) / sigmaSqrtDt - z) / (x0 * x0 * sigmaSqrtDt);
+    }
+
+    //! Mean and error of the greeks of a run
+    struct GreekStatistics {
+        StreamingStatistics delta, gamma, vega;
+
+        bool empty() const { return delta.samples() == 0; }
+        void add(const PathGreeks& greeks, Real weight) {
+            delta.add(greeks.delta, weight);
+            gamma.add(greeks.gamma, weight);
+            vega.add(greeks.vega, weight);
+        }
+        void merge(const GreekStatistics& other) {
+            delta.merge(other.delta);
+            gamma.merge(other.gamma);
+            vega.merge(other.vega);
+        }
+        //! writes the error estimates to an engine's results
+        void addErrorsTo(std::map<std::string, ext::any>& results) const {
+            results["deltaErrorEstimate"] = delta.errorEstimate();
+            results["gammaErrorEstimate"] = gamma.errorEstimate();
+            results["vegaErrorEstimate"] = vega.errorEstimate();
+        }
+    };
+
+    //! Monte Carlo model pricing each path with its greeks
+    /*! Same sampling loop as PathMonteCarloModel; the values go to the
+        S accumulator, which drives the tolerance, and the greeks to a
+        GreekStatistics.  A control variate only corrects the value.
+    */
+    template <class RNG, class S, class PG>
+    class GreeksMonteCarloModel {
+      public:
+        typedef SingleVariate<RNG> mc_traits;
+        typedef PG path_generator_type;
+        typedef typename mc_traits::path_pricer_type path_pricer_type;
+        typedef typename path_generator_type::sample_type sample_type;
+        typedef Real result_type;
+        typedef S stats_type;
+
+        GreeksMonteCarloModel(ext::shared_ptr<path_generator_type> pathGenerator,
+                              ext::shared_ptr<GreekPathPricer> pathPricer,
+                              bool antitheticVariate,
+                              ext::shared_ptr<path_pricer_type> cvPathPricer =
+                                  ext::shared_ptr<path_pricer_type>(),
+                              Real cvOptionValue = 0.0)
+        : pathGenerator_(std::move(pathGenerator)),
+          pathPricer_(std::move(pathPricer)),
+          antitheticVariate_(antitheticVariate),
+          cvPathPricer_(std::move(cvPathPricer)),
+          cvOptionValue_(cvOptionValue) {}
+        void addSamples(Size samples);
+        const S& sampleAccumulator() const { return sampleAccumulator_; }
+        const GreekStatistics& greeks() const { return greeks_; }
+        const McProfile& profile() const { return profile_; }
+      private:
+        PathGreeks price(const Path& path) const {
+            PathGreeks greeks = pathPricer_->greeks(path);
+            if (cvPathPricer_)
+                greeks.value += cvOptionValue_ - (*cvPathPricer_)(path);
+            return greeks;
+        }
+        ext::shared_ptr<path_generator_type> pathGenerator_;
+        ext::shared_ptr<GreekPathPricer> pathPricer_;
+        bool antitheticVariate_;
+        ext::shared_ptr<path_pricer_type> cvPathPricer_;
+        Real cvOptionValue_;
+        S sampleAccumulator_;
+        GreekStatistics greeks_;
+        McProfile profile_;
+    };
+
+    template <class RNG, class S, class PG>
+    inline void GreeksMonteCarloModel<RNG,S,PG>::addSamples(Size samples) {
+        for (Size j = 0; j < samples; ++j) {
+            const sample_type* path;
+            {
+                QL_MC_PROFILE_PHASE(profile_, PathConstruction);
+                path = &pathGenerator_->next();
+            }
+            QL_MC_PROFILE_ONLY(++profile_.paths);
+            QL_MC_PROFILE_ONLY(profile_.randomDraws += path->value.length() - 1);
+
+            PathGreeks greeks;
+            {
+                QL_MC_PROFILE_PHASE(profile_, Pricing);
+                greeks = price(path->value);
+            }
+
+            if (antitheticVariate_) {
+                {
+                    QL_MC_PROFILE_PHASE(profile_, PathConstruction);
+                    path = &pathGenerator_->antithetic();
+                }
+                QL_MC_PROFILE_ONLY(++profile_.paths);
+                QL_MC_PROFILE_PHASE(profile_, Pricing);
+                PathGreeks other = price(path->value);
+                greeks.value = (greeks.value + other.value) / 2.0;
+                greeks.delta = (greeks.delta + other.delta) / 2.0;
+                greeks.gamma = (greeks.gamma + other.gamma) / 2.0;
+                greeks.vega = (greeks.vega + other.vega) / 2.0;
+            }
+
+            QL_MC_PROFILE_PHASE(profile_, Accumulation);
+            sampleAccumulator_.add(greeks.value, path->weight);
+            greeks_.add(greeks, path->weight);
+        }
+    }
+
+    namespace detail {
+
+        template <class M, class = void>
+        struct has_greeks : std::false_type {};
+
+        template <class M>
+        struct has_greeks<M, decltype(void(std::declval<const M&>().greeks()))>
+        : std::true_type {};
+
+    }
+
+    //! greeks of a model, or empty statistics if the model computes none
+    template <class Model>
+    inline GreekStatistics greeksOf(const Model& model) {
+        if constexpr (detail::has_greeks<Model>::value)
+            return model.greeks();
+        else
+            return GreekStatistics();
+    }
+
+} // namespace QuantLib
+
+#endif
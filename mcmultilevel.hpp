@@ -0,0 +1,285 @@
+#ifndef QL_MCMULTILEVEL_HPP
+#define QL_MCMULTILEVEL_HPP
+
+#include <ql/math/comparison.hpp>
+#include <ql/methods/montecarlo/path.hpp>
+#include <ql/methods/montecarlo/pathpricer.hpp>
+#include <ql/shared_ptr.hpp>
+#include <ql/stochasticprocess.hpp>
+#include <ql/timegrid.hpp>
+#include <ql/utilities/null.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "mcparallel.hpp"
+
+namespace QuantLib {
+
+    //------------------------------------------------------------------------
+    // Multi-level Monte Carlo (Giles, 2008):
+    //   - the price on the finest grid is the price on the coarsest grid
+    //     plus the corrections between successive grids, each grid
+    //     splitting every step of the previous one in two
+    //   - the correction of a level is sampled on coupled paths: the
+    //     coarse path is driven by the sums of the fine Brownian
+    //     increments, so that the variance of the correction decreases
+    //     with the step and most samples go to the cheap coarse levels
+    //   - the samples of each level follow from the observed variances
+    //     V_l and costs C_l, N_l being proportional to sqrt(V_l / C_l)
+    //------------------------------------------------------------------------
+
+    //! grid made of every other node of \c grid
+    inline TimeGrid coarsenedTimeGrid(const TimeGrid& grid) {
+        QL_REQUIRE(grid.size() > 1 && (grid.size() - 1) % 2 == 0,
+                   "a grid of " << grid.size() - 1
+                   << " steps cannot be coarsened");
+        std::vector<Time> times;
+        times.reserve((grid.size() - 1) / 2);
+        for (Size i = 2; i < grid.size(); i += 2)
+            times.push_back(grid[i]);
+        return TimeGrid(times.begin(), times.end());
+    }
+
+    //! Samples of one level of a multi-level simulation
+    /*! Each sample is the value of a path on the fine grid minus the
+        value of the coupled path on the coarse grid, whose steps are
+        pairs of fine steps driven by the same normals.  Both paths are
+        built step by step with the process' evolve().  At level 0 there
+        is no coarse pricer and coarseGrid is not used.
+    */
+    template <class RNG, class S>
+    class MultilevelMonteCarloModel {
+      public:
+        typedef S stats_type;
+        typedef PathPricer<Path> path_pricer_type;
+
+        MultilevelMonteCarloModel(
+                        ext::shared_ptr<StochasticProcess1D> process,
+                        const TimeGrid& fineGrid,
+                        const TimeGrid& coarseGrid,
+                        ext::shared_ptr<path_pricer_type> finePricer,
+                        ext::shared_ptr<path_pricer_type> coarsePricer,
+                        bool antitheticVariate,
+                        BigNatural seed);
+        void addSamples(Size samples);
+        const S& sampleAccumulator() const { return sampleAccumulator_; }
+        //! steps simulated per sample, on both grids
+        Size cost() const {
+            return (fine_.length() - 1) + (coarsePricer_ ? coarse_.length() - 1 : 0);
+        }
+      private:
+        Real price(Real sign) const;
+        ext::shared_ptr<StochasticProcess1D> process_;
+        typename RNG::rsg_type generator_;
+        ext::shared_ptr<path_pricer_type> finePricer_, coarsePricer_;
+        bool antitheticVariate_;
+        // weights of the two fine normals in each coarse normal
+        std::vector<Real> first_, second_;
+        std::vector<Real> z_;
+        mutable Path fine_, coarse_;
+        S sampleAccumulator_;
+    };
+
+    //------------------------------------------------------------------------
+    // simulateMultilevel(levels, threads, makeModel, ...) :
+    //   - makeModel(l, i) builds the model of level l (0 being the
+    //     coarsest grid) for the i-th worker, with its own seed; the
+    //     workers of a level run as a ParallelMonteCarloModel
+    //   - a first run of minSamples samples per level estimates the
+    //     variances.  With a tolerance, N_l = tol^-2 sqrt(V_l/C_l)
+    //     sum_k sqrt(V_k C_k) gives sum_l V_l/N_l = tol^2 at the least
+    //     cost, and the levels are topped up until the error is below
+    //     tolerance; with a number of samples N, the cost of N paths on
+    //     the finest grid is split in the same proportions
+    //   - returns the sum of the level means and the error
+    //     sqrt(sum_l V_l/N_l); the report gets the samples of each level
+    //   - the error only covers the sampling, not the bias of the finest
+    //     grid
+    //------------------------------------------------------------------------
+    template <class ModelFactory>
+    inline std::pair<Real, Real> simulateMultilevel(Size levels,
+                                                    Size threads,
+                                                    const ModelFactory& makeModel,
+                                                    Real requiredTolerance,
+                                                    Size requiredSamples,
+                                                    Size maxSamples,
+                                                    SamplingReport* report = nullptr,
+                                                    Size minSamples = 1023) {
+        typedef typename std::decay<decltype(*makeModel(Size(0), Size(0)))>::type
+            model_type;
+        QL_REQUIRE(levels > 0, "at least one level required");
+        QL_REQUIRE(threads > 0, "at least one thread required");
+        QL_REQUIRE(requiredTolerance != Null<Real>() ||
+                   requiredSamples != Null<Size>(),
+                   "neither tolerance nor number of samples set");
+        if (maxSamples == Null<Size>())
+            maxSamples = QL_MAX_INTEGER;
+
+        std::vector<ParallelMonteCarloModel<model_type> > models;
+        std::vector<Real> costs;
+        models.reserve(levels);
+        for (Size l = 0; l < levels; ++l) {
+            std::vector<ext::shared_ptr<model_type> > workers;
+            for (Size i = 0; i < threads; ++i)
+                workers.push_back(makeModel(l, i));
+            costs.push_back(Real(workers.front()->cost()));
+            models.emplace_back(std::move(workers));
+        }
+        // lazily-initialized state is set up before the threads start
+        if (threads > 1)
+            makeModel(0, threads)->addSamples(1);
+
+        SamplingReport r;
+        r.levelSamples.assign(levels, 0);
+        auto start = std::chrono::steady_clock::now();
+        auto addSamples = [&](Size l, Size samples) {
+            QL_REQUIRE(r.levelSamples[l] + samples <= maxSamples,
+                       "max number of samples (" << maxSamples
+                       << ") reached at level " << l);
+            models[l].addSamples(samples);
+            r.levelSamples[l] += samples;
+            ++r.batches;
+        };
+        // N_l = scale sqrt(V_l/C_l); false if no level needs more samples
+        auto topUp = [&](Real scale) {
+            bool added = false;
+            for (Size l = 0; l < levels; ++l) {
+                Real v = models[l].sampleAccumulator().variance();
+                Size target = Size(std::ceil(scale * std::sqrt(v / costs[l])));
+                if (target > r.levelSamples[l]) {
+                    addSamples(l, target - r.levelSamples[l]);
+                    added = true;
+                }
+            }
+            return added;
+        };
+        auto spread = [&]() {
+            Real sum = 0.0;
+            for (Size l = 0; l < levels; ++l)
+                sum += std::sqrt(models[l].sampleAccumulator().variance() * costs[l]);
+            return sum;
+        };
+        auto error = [&]() {
+            Real variance = 0.0;
+            for (Size l = 0; l < levels; ++l) {
+                Real e = models[l].sampleAccumulator().errorEstimate();
+                variance += e * e;
+            }
+            return std::sqrt(variance);
+        };
+
+        Real totalCost = 0.0;
+        for (Real c : costs)
+            totalCost += c;
+        if (requiredTolerance == Null<Real>()) {
+            // the cost of requiredSamples paths on the finest grid
+            Real budget = Real(requiredSamples) * costs.back();
+            Size first = Size(std::max(2.0, std::min<Real>(Real(minSamples),
+                                                           budget / totalCost)));
+            for (Size l = 0; l < levels; ++l)
+                addSamples(l, first);
+            Real sum = spread();
+            if (sum > 0.0)
+                topUp(budget / sum);
+        } else {
+            for (Size l = 0; l < levels; ++l)
+                addSamples(l, std::max<Size>(minSamples, 2));
+            // the targets meet the tolerance with the variances they were
+            // computed from; only new variance estimates call for more
+            while (error() > requiredTolerance) {
+                Real sum = spread();
+                if (!topUp(sum / (requiredTolerance * requiredTolerance)))
+                    break;
+            }
+        }
+
+        Real mean = 0.0;
+        for (Size l = 0; l < levels; ++l)
+            mean += models[l].sampleAccumulator().mean();
+        for (Size n : r.levelSamples)
+            r.samples += n;
+        r.elapsedTime = std::chrono::duration<Real>(
+            std::chrono::steady_clock::now() - start).count();
+        if (report != nullptr)
+            *report = r;
+        return std::make_pair(mean, error());
+    }
+
+
+    // template definitions
+
+    template <class RNG, class S>
+    inline MultilevelMonteCarloModel<RNG,S>::MultilevelMonteCarloModel(
+                        ext::shared_ptr<StochasticProcess1D> process,
+                        const TimeGrid& fineGrid,
+                        const TimeGrid& coarseGrid,
+                        ext::shared_ptr<path_pricer_type> finePricer,
+                        ext::shared_ptr<path_pricer_type> coarsePricer,
+                        bool antitheticVariate,
+                        BigNatural seed)
+    : process_(std::move(process)),
+      generator_(RNG::make_sequence_generator(fineGrid.size() - 1, seed)),
+      finePricer_(std::move(finePricer)), coarsePricer_(std::move(coarsePricer)),
+      antitheticVariate_(antitheticVariate),
+      z_(fineGrid.size() - 1), fine_(fineGrid),
+      coarse_(coarsePricer_ ? coarseGrid : fineGrid) {
+        if (coarsePricer_) {
+            Size steps = coarseGrid.size() - 1;
+            QL_REQUIRE(fineGrid.size() - 1 == 2 * steps,
+                       "the fine grid must have twice the steps of the "
+                       "coarse one");
+            for (Size j = 0; j < steps; ++j) {
+                QL_REQUIRE(close_enough(fineGrid[2 * j + 2], coarseGrid[j + 1]),
+                           "the coarse grid must be every other node of "
+                           "the fine grid");
+                Time dt1 = fineGrid.dt(2 * j), dt2 = fineGrid.dt(2 * j + 1);
+                first_.push_back(std::sqrt(dt1 / (dt1 + dt2)));
+                second_.push_back(std::sqrt(dt2 / (dt1 + dt2)));
+            }
+        }
+    }
+
+    template <class RNG, class S>
+    inline Real MultilevelMonteCarloModel<RNG,S>::price(Real sign) const {
+        const TimeGrid& grid = fine_.timeGrid();
+        Real x = process_->x0();
+        fine_[0] = x;
+        for (Size i = 0; i < z_.size(); ++i)
+            fine_[i + 1] = x = process_->evolve(grid[i], x, grid.dt(i),
+                                                sign * z_[i]);
+        Real value = (*finePricer_)(fine_);
+        if (coarsePricer_) {
+            const TimeGrid& coarseGrid = coarse_.timeGrid();
+            x = process_->x0();
+            coarse_[0] = x;
+            for (Size j = 0; j < first_.size(); ++j) {
+                Real w = first_[j] * z_[2 * j] + second_[j] * z_[2 * j + 1];
+                coarse_[j + 1] = x = process_->evolve(coarseGrid[j], x,
+                                                      coarseGrid.dt(j),
+                                                      sign * w);
+            }
+            value -= (*coarsePricer_)(coarse_);
+        }
+        return value;
+    }
+
+    template <class RNG, class S>
+    inline void MultilevelMonteCarloModel<RNG,S>::addSamples(Size samples) {
+        for (Size j = 0; j < samples; ++j) {
+            const typename RNG::rsg_type::sample_type& sequence =
+                generator_.nextSequence();
+            std::copy(sequence.value.begin(), sequence.value.end(), z_.begin());
+            Real value = price(1.0);
+            if (antitheticVariate_)
+                value = (value + price(-1.0)) / 2.0;
+            sampleAccumulator_.add(value, sequence.weight);
+        }
+    }
+
+} // namespace QuantLib
+
+#endif
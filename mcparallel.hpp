@@ -0,0 +1,252 @@
+#ifndef QL_MCPARALLEL_HPP
+#define QL_MCPARALLEL_HPP
+
+#include <ql/errors.hpp>
+#include <ql/shared_ptr.hpp>
+#include <ql/types.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "mcallocationcounter.hpp"
+#include "mcsamplingloop.hpp"
+#include "streamingstatistics.hpp"
+
+namespace QuantLib {
+
+    //------------------------------------------------------------------------
+    // deriveSeed(seed, i) :
+    //   - seed of the i-th worker, derived deterministically from the
+    //     engine seed (splitmix64 mixing)
+    //   - worker 0 keeps the engine seed, so that a single worker
+    //     reproduces the serial simulation
+    //   - seed 0 (random seeding) is left as is
+    //------------------------------------------------------------------------
+    inline BigNatural deriveSeed(BigNatural seed, Size index) {
+        if (seed == 0 || index == 0)
+            return seed;
+        std::uint64_t z = std::uint64_t(seed)
+                        + 0x9E3779B97F4A7C15ULL * std::uint64_t(index);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        z ^= z >> 31;
+        // Mersenne Twister only uses the lower 32 bits of its seed
+        BigNatural derived = BigNatural(z & 0xffffffffULL);
+        return derived != 0 ? derived : 1;
+    }
+
+    namespace detail {
+
+        template <class S, class = void>
+        struct has_sample_data : std::false_type {};
+
+        template <class S>
+        struct has_sample_data<S, decltype(void(std::declval<const S&>().data()))>
+        : std::true_type {};
+
+        template <class S, class = void>
+        struct has_merge : std::false_type {};
+
+        template <class S>
+        struct has_merge<S, decltype(void(std::declval<S&>().merge(std::declval<const S&>())))>
+        : std::true_type {};
+
+    }
+
+    //! adds the samples collected in \c from to \c into
+    /*! Works for accumulators that can merge another one, such as
+        StreamingStatistics, and for those that store their samples, such
+        as GeneralStatistics and the Statistics class built on it.
+    */
+    template <class S>
+    inline void mergeStatistics(S& into, const S& from) {
+        if constexpr (detail::has_merge<S>::value) {
+            into.merge(from);
+        } else if constexpr (detail::has_sample_data<S>::value) {
+            for (const auto& sample : from.data())
+                into.add(sample.first, sample.second);
+        } else {
+            QL_FAIL("statistics type cannot be merged across threads");
+        }
+    }
+
+    //! adds the samples of \c from not yet in \c into
+    /*! \c merged is the number of samples of \c from already added to
+        \c into, updated on return.  Only accumulators storing their
+        samples can tell the new ones apart; for the others nothing is
+        done and false is returned, and they must be merged again with
+        mergeStatistics().
+    */
+    template <class S>
+    inline bool mergeNewSamples(S& into, const S& from, Size& merged) {
+        if constexpr (detail::has_sample_data<S>::value) {
+            const auto& data = from.data();
+            for (Size j = merged; j < data.size(); ++j)
+                into.add(data[j].first, data[j].second);
+            merged = data.size();
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    //! runs work(i) for i in [0, tasks) on at most \c threads threads
+    /*! Thread w runs the tasks i with i % threads == w, thread 0 being the
+        calling one.  The first exception thrown, in task order, is
+        rethrown once all the threads are done.
+    */
+    template <class Work>
+    inline void runConcurrently(Size tasks, Size threads, const Work& work) {
+        threads = std::min(threads, tasks);
+        std::vector<std::exception_ptr> errors(tasks);
+        auto run = [&](Size w) {
+            for (Size i = w; i < tasks; i += threads) {
+                try {
+                    work(i);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(threads > 0 ? threads - 1 : 0);
+        for (Size w = 1; w < threads; ++w)
+            workers.emplace_back(run, w);
+        if (threads > 0)
+            run(0);
+        for (auto& t : workers)
+            t.join();
+        for (auto& e : errors)
+            if (e)
+                std::rethrow_exception(e);
+    }
+
+    //! Runs several Monte Carlo models concurrently
+    /*! Model must provide addSamples(Size), sampleAccumulator() and a
+        stats_type typedef, as MonteCarloModel does.  Each call to
+        addSamples() splits the samples evenly across the models, runs each
+        of them on its own thread and merges their new samples in model
+        order; results therefore only depend on the models' seeds, on the
+        number of threads and on the batches drawn.
+
+        Accumulators storing their samples (Statistics) are only extended
+        with the samples of the last batch, but they are still held twice,
+        by the models and by the merged accumulator.
+    */
+    template <class Model>
+    class ParallelMonteCarloModel {
+      public:
+        typedef typename Model::stats_type stats_type;
+
+        explicit ParallelMonteCarloModel(
+                               std::vector<ext::shared_ptr<Model> > models)
+        : models_(std::move(models)), merged_(models_.size(), 0) {
+            QL_REQUIRE(!models_.empty(), "no models given");
+        }
+        void addSamples(Size samples);
+        const stats_type& sampleAccumulator() const {
+            return sampleAccumulator_;
+        }
+        //! pooled group averages of the models, if they draw groups
+        const StreamingStatistics& groupStatistics() const {
+            return groupStatistics_;
+        }
+      private:
+        std::vector<ext::shared_ptr<Model> > models_;
+        // samples of each model already in sampleAccumulator_
+        std::vector<Size> merged_;
+        stats_type sampleAccumulator_;
+        StreamingStatistics groupStatistics_;
+    };
+
+    template <class Model>
+    inline void ParallelMonteCarloModel<Model>::addSamples(Size samples) {
+        Size n = models_.size();
+        runConcurrently(n, n, [&](Size i) {
+            models_[i]->addSamples(samples / n + (i < samples % n ? 1 : 0));
+        });
+
+        bool incremental = true;
+        for (Size i = 0; i < n && incremental; ++i)
+            incremental = mergeNewSamples(sampleAccumulator_,
+                                          models_[i]->sampleAccumulator(),
+                                          merged_[i]);
+        if (!incremental) {
+            sampleAccumulator_ = stats_type();
+            for (const auto& m : models_)
+                mergeStatistics(sampleAccumulator_, m->sampleAccumulator());
+        }
+        groupStatistics_ = StreamingStatistics();
+        for (const auto& m : models_)
+            groupStatistics_.merge(groupStatisticsOf(*m));
+    }
+
+    //------------------------------------------------------------------------
+    // simulateInParallel(threads, makeModel, ...) :
+    //   - makeModel(i) builds the model of the i-th worker (its own path
+    //     generator, seeded with deriveSeed(seed, i), and its own pricer)
+    //   - models are built on the calling thread, and one throwaway sample
+    //     is drawn there too, so that lazily-initialized process and
+    //     term-structure state is never set up concurrently
+    //   - returns the merged accumulator
+    //   - with a single thread the model is simply run in place
+    //   - if report is given, it receives the samples used, the sampling
+    //     time and the heap allocations made by the workers while sampling
+    //     (see AllocationCountingModel), and the group averages from which
+    //     the error must be estimated if the paths are not independent
+    //------------------------------------------------------------------------
+    template <class ModelFactory>
+    inline auto simulateInParallel(Size threads,
+                                   const ModelFactory& makeModel,
+                                   Real requiredTolerance,
+                                   Size requiredSamples,
+                                   Size maxSamples,
+                                   SamplingReport* report = nullptr) {
+        typedef typename std::decay<decltype(*makeModel(Size(0)))>::type
+            model_type;
+        typedef AllocationCountingModel<model_type> counting_model_type;
+        QL_REQUIRE(threads > 0, "at least one thread required");
+
+        if (threads == 1) {
+            counting_model_type model(makeModel(0));
+            SamplingReport r = simulateSamples(model, requiredTolerance,
+                                               requiredSamples, maxSamples);
+            if (report != nullptr) {
+                *report = r;
+                report->sampleAllocations = model.allocations();
+                report->profile = model.profile();
+                report->greeks = model.greeks();
+                report->scenarios = model.scenarios();
+                report->groupStatistics = model.groupStatistics();
+            }
+            return model.sampleAccumulator();
+        }
+
+        std::vector<ext::shared_ptr<counting_model_type> > models;
+        models.reserve(threads);
+        for (Size i = 0; i < threads; ++i)
+            models.push_back(ext::make_shared<counting_model_type>(makeModel(i)));
+        makeModel(threads)->addSamples(1);
+
+        ParallelMonteCarloModel<counting_model_type> model(models);
+        SamplingReport r = simulateSamples(model, requiredTolerance,
+                                           requiredSamples, maxSamples);
+        if (report != nullptr) {
+            *report = r;
+            report->sampleAllocations = countedAllocations(models);
+            report->profile = countedProfile(models);
+            report->greeks = countedGreeks(models);
+            report->scenarios = countedScenarios(models);
+            report->groupStatistics = countedGroupStatistics(models);
+        }
+        return model.sampleAccumulator();
+    }
+
+} // namespace QuantLib
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef QL_MCPATHMODEL_HPP
+#define QL_MCPATHMODEL_HPP
+
+#include <ql/methods/montecarlo/mctraits.hpp>
+#include <ql/shared_ptr.hpp>
+#include <utility>
+
+#include "mcprofiler.hpp"
+
+namespace QuantLib {
+
+    //! Monte Carlo model over the paths of a single-variate path generator
+    /*! Draws the same samples as MonteCarloModel, antithetic and control
+        variates included (the control is priced on the same path).  The
+        path is read in place from the generator instead of being copied
+        for each sample, and the phases of the loop can be profiled (see
+        mcprofiler.hpp).
+
+        MonteCarloModel copies a Sample<Path>, and so allocates, for every
+        sample; this model allocates nothing while sampling, which is what
+        makes the path-by-path modes of the _2 engines allocation-free
+        (see mcallocationcounter.hpp and "make test-alloc").
+
+        PG is PathGenerator by default; any generator with next() and
+        antithetic() returning a Sample<Path> can be used, e.g.
+        LogNormalPathGenerator, whose calls are then resolved statically.
+    */
+    template <class RNG, class S,
+              class PG = typename SingleVariate<RNG>::path_generator_type>
+    class PathMonteCarloModel {
+      public:
+        typedef SingleVariate<RNG> mc_traits;
+        typedef PG path_generator_type;
+        typedef typename mc_traits::path_pricer_type path_pricer_type;
+        typedef typename path_generator_type::sample_type sample_type;
+        typedef typename path_pricer_type::result_type result_type;
+        typedef S stats_type;
+
+        PathMonteCarloModel(ext::shared_ptr<path_generator_type> pathGenerator,
+                            ext::shared_ptr<path_pricer_type> pathPricer,
+                            bool antitheticVariate,
+                            ext::shared_ptr<path_pricer_type> cvPathPricer =
+                                ext::shared_ptr<path_pricer_type>(),
+                            result_type cvOptionValue = result_type())
+        : pathGenerator_(std::move(pathGenerator)),
+          pathPricer_(std::move(pathPricer)),
+          antitheticVariate_(antitheticVariate),
+          cvPathPricer_(std::move(cvPathPricer)),
+          cvOptionValue_(cvOptionValue) {}
+        void addSamples(Size samples);
+        const S& sampleAccumulator() const { return sampleAccumulator_; }
+        const McProfile& profile() const { return profile_; }
+      private:
+        result_type price(const Path& path) const;
+        ext::shared_ptr<path_generator_type> pathGenerator_;
+        ext::shared_ptr<path_pricer_type> pathPricer_;
+        bool antitheticVariate_;
+        ext::shared_ptr<path_pricer_type> cvPathPricer_;
+        result_type cvOptionValue_;
+        S sampleAccumulator_;
+        McProfile profile_;
+    };
+
+
+    // template definitions
+
+    template <class RNG, class S, class PG>
+    inline typename PathMonteCarloModel<RNG,S,PG>::result_type
+    PathMonteCarloModel<RNG,S,PG>::price(const Path& path) const {
+        result_type value = (*pathPricer_)(path);
+        if (cvPathPricer_)
+            value += cvOptionValue_ - (*cvPathPricer_)(path);
+        return value;
+    }
+
+    template <class RNG, class S, class PG>
+    inline void PathMonteCarloModel<RNG,S,PG>::addSamples(Size samples) {
+        for (Size j = 0; j < samples; ++j) {
+            // next() and antithetic() return the generator's own sample
+            const sample_type* path;
+            {
+                QL_MC_PROFILE_PHASE(profile_, PathConstruction);
+                path = &pathGenerator_->next();
+            }
+            QL_MC_PROFILE_ONLY(++profile_.paths);
+            QL_MC_PROFILE_ONLY(profile_.randomDraws += path->value.length() - 1);
+            QL_MC_PROFILE_ONLY(profile_.steps += path->value.length() - 1);
+
+            result_type value;
+            {
+                QL_MC_PROFILE_PHASE(profile_, Pricing);
+                value = price(path->value);
+            }
+
+            if (antitheticVariate_) {
+                {
+                    QL_MC_PROFILE_PHASE(profile_, PathConstruction);
+                    path = &pathGenerator_->antithetic();
+                }
+                QL_MC_PROFILE_ONLY(++profile_.paths);
+                QL_MC_PROFILE_ONLY(profile_.steps += path->value.length() - 1);
+                {
+                    QL_MC_PROFILE_PHASE(profile_, Pricing);
+                    value = (value + price(path->value)) / 2.0;
+                }
+            }
+
+            QL_MC_PROFILE_PHASE(profile_, Accumulation);
+            sampleAccumulator_.add(value, path->weight);
+        }
+    }
+
+} // namespace QuantLib
+
+#endif
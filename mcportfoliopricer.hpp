@@ -0,0 +1,654 @@
+#ifndef mc_portfolio_pricer_hpp
+#define mc_portfolio_pricer_hpp
+
+#include <ql/exercise.hpp>
+#include <ql/instruments/asianoption.hpp>
+#include <ql/instruments/barrieroption.hpp>
+#include <ql/instruments/europeanoption.hpp>
+#include <ql/methods/montecarlo/mctraits.hpp>
+#include <ql/methods/montecarlo/pathgenerator.hpp>
+#include <ql/methods/montecarlo/pathpricer.hpp>
+#include <ql/math/statistics/statistics.hpp>
+#include <ql/processes/blackscholesprocess.hpp>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "myconstutil.hpp"
+#include "piecewiseconstantblackscholesprocess.hpp"
+#include "mcparallel.hpp"
+#include "mcrandomizedqmc.hpp"
+#include "streamingstatistics.hpp"
+
+namespace QuantLib {
+
+    //! Monte Carlo results of one instrument of the portfolio
+    struct PortfolioResult {
+        Real value;
+        Real errorEstimate;
+    };
+
+    //! One accumulator per instrument
+    /*! samples() is common to all instruments; errorEstimate() is the
+        largest error, so that simulateSamples() stops when every
+        instrument has reached the required tolerance.
+    */
+    template <class S>
+    class PortfolioStatistics {
+      public:
+        explicit PortfolioStatistics(Size instruments = 0)
+        : stats_(instruments) {}
+        Size size() const { return stats_.size(); }
+        S& operator[](Size i) { return stats_[i]; }
+        const S& operator[](Size i) const { return stats_[i]; }
+        Size samples() const {
+            return stats_.empty() ? 0 : stats_[0].samples();
+        }
+        Real errorEstimate() const {
+            Real error = 0.0;
+            for (const auto& s : stats_)
+                error = std::max<Real>(error, s.errorEstimate());
+            return error;
+        }
+      private:
+        std::vector<S> stats_;
+    };
+
+    //! merges the per-instrument accumulators of two workers
+    template <class S>
+    inline void mergeStatistics(PortfolioStatistics<S>& into,
+                                const PortfolioStatistics<S>& from) {
+        if (into.size() == 0)
+            into = PortfolioStatistics<S>(from.size());
+        QL_REQUIRE(into.size() == from.size(), "portfolio size mismatch");
+        for (Size i = 0; i < from.size(); ++i)
+            mergeStatistics(into[i], from[i]);
+    }
+
+    //! adds the new samples of every instrument, see mergeNewSamples()
+    template <class S>
+    inline bool mergeNewSamples(PortfolioStatistics<S>& into,
+                                const PortfolioStatistics<S>& from,
+                                Size& merged) {
+        if (into.size() == 0)
+            into = PortfolioStatistics<S>(from.size());
+        QL_REQUIRE(into.size() == from.size(), "portfolio size mismatch");
+        // every instrument has the same samples
+        Size m = merged;
+        for (Size i = 0; i < from.size(); ++i) {
+            m = merged;
+            if (!mergeNewSamples(into[i], from[i], m))
+                return false;
+        }
+        merged = m;
+        return true;
+    }
+
+
+    //------------------------------------------------------------------------
+    // Path pricers working on the nodes of the common time grid
+    //------------------------------------------------------------------------
+
+    //! European payoff on the node of the exercise date
+    class EuropeanNodePathPricer : public PathPricer<Path> {
+      public:
+        EuropeanNodePathPricer(Option::Type type,
+                               Real strike,
+                               DiscountFactor discount,
+                               Size exerciseNode)
+        : payoff_(type, strike), discount_(discount),
+          exerciseNode_(exerciseNode) {}
+        Real operator()(const Path& path) const override {
+            return payoff_(path[exerciseNode_]) * discount_;
+        }
+      private:
+        PlainVanillaPayoff payoff_;
+        DiscountFactor discount_;
+        Size exerciseNode_;
+    };
+
+    //! ArithmeticASOPathPricer on the nodes of the fixing dates
+    /*! As in ArithmeticASOPathPricer, the strike is the average of the
+        fixings (past and simulated) and the payoff is paid on the last
+        fixing.
+    */
+    class ArithmeticASONodePathPricer : public PathPricer<Path> {
+      public:
+        ArithmeticASONodePathPricer(Option::Type type,
+                                    DiscountFactor discount,
+                                    Real runningSum,
+                                    Size pastFixings,
+                                    std::vector<Size> fixingNodes)
+        : type_(type), discount_(discount), runningSum_(runningSum),
+          pastFixings_(pastFixings), fixingNodes_(std::move(fixingNodes)) {
+            QL_REQUIRE(!fixingNodes_.empty(), "no future fixings given");
+        }
+        Real operator()(const Path& path) const override {
+            Real sum = runningSum_;
+            for (Size node : fixingNodes_)
+                sum += path[node];
+            Real averageStrike = sum / (pastFixings_ + fixingNodes_.size());
+            return discount_ *
+                PlainVanillaPayoff(type_, averageStrike)(path[fixingNodes_.back()]);
+        }
+      private:
+        Option::Type type_;
+        DiscountFactor discount_;
+        Real runningSum_;
+        Size pastFixings_;
+        std::vector<Size> fixingNodes_;
+    };
+
+    //! BarrierPathPricer / BiasedBarrierPathPricer up to a given node
+    /*! Same crossing rules, monitoring every node of the common grid up to
+        the exercise date.  discounts[i] is the discount factor of node i.
+    */
+    class BarrierNodePathPricer : public PathPricer<Path> {
+      public:
+        BarrierNodePathPricer(Barrier::Type barrierType,
+                              Real barrier,
+                              Real rebate,
+                              Option::Type type,
+                              Real strike,
+                              std::vector<DiscountFactor> discounts,
+                              ext::shared_ptr<StochasticProcess1D> diffProcess,
+                              bool isBiased,
+                              PseudoRandom::ursg_type sequenceGen)
+        : barrierType_(barrierType), barrier_(barrier), rebate_(rebate),
+          payoff_(type, strike), discounts_(std::move(discounts)),
+          diffProcess_(std::move(diffProcess)), isBiased_(isBiased),
+          sequenceGen_(std::move(sequenceGen)) {
+            QL_REQUIRE(barrier_ > 0.0,
+                       "barrier less/equal to zero not allowed");
+        }
+        Real operator()(const Path& path) const override;
+      private:
+        Barrier::Type barrierType_;
+        Real barrier_;
+        Real rebate_;
+        PlainVanillaPayoff payoff_;
+        std::vector<DiscountFactor> discounts_;
+        ext::shared_ptr<StochasticProcess1D> diffProcess_;
+        bool isBiased_;
+        mutable PseudoRandom::ursg_type sequenceGen_;
+    };
+
+
+    //! Monte Carlo model feeding each path to all the instrument pricers
+    template <class RNG, class S>
+    class PortfolioMonteCarloModel {
+      public:
+        typedef PathGenerator<typename RNG::rsg_type> path_generator_type;
+        typedef PortfolioStatistics<S> stats_type;
+
+        PortfolioMonteCarloModel(
+               ext::shared_ptr<path_generator_type> pathGenerator,
+               std::vector<ext::shared_ptr<PathPricer<Path> > > pathPricers,
+               bool antitheticVariate)
+        : pathGenerator_(std::move(pathGenerator)),
+          pathPricers_(std::move(pathPricers)),
+          antitheticVariate_(antitheticVariate),
+          values_(pathPricers_.size()),
+          sampleAccumulator_(pathPricers_.size()) {}
+        void addSamples(Size samples);
+        const stats_type& sampleAccumulator() const {
+            return sampleAccumulator_;
+        }
+      private:
+        ext::shared_ptr<path_generator_type> pathGenerator_;
+        std::vector<ext::shared_ptr<PathPricer<Path> > > pathPricers_;
+        bool antitheticVariate_;
+        std::vector<Real> values_;
+        stats_type sampleAccumulator_;
+    };
+
+
+    //! Prices several options on one process with a single simulation
+    /*! European, discrete arithmetic average-strike Asian and barrier
+        options are simulated on the union of their dates, refined to at
+        least the given number of steps; every path is priced by all the
+        instruments.  Results are returned in the order of add(); an
+        option whose exercise date is not after the evaluation date is
+        left out of the simulation and reported with a null value and
+        error.
+
+        With constant parameters, the process is constant on each step of
+        the common grid (see makePiecewiseConstantProcess), so that every
+        option sees the rates and variance of the curves at its own dates;
+        the volatility is read at the money, there being no single strike.
+
+        The default accumulator keeps one mean and variance per instrument,
+        whatever the number of samples.
+
+        Randomized QMC (ScrambledSobol) is refused: its error would need
+        independent replicates, which the per-instrument accumulators do
+        not keep.
+    */
+    template <class RNG = PseudoRandom, class S = StreamingStatistics>
+    class MCPortfolioPricer {
+      public:
+        explicit MCPortfolioPricer(
+                    ext::shared_ptr<GeneralizedBlackScholesProcess> process);
+        // instruments, returns their index in the results
+        Size add(const EuropeanOption& option);
+        Size add(const DiscreteAveragingAsianOption& option);
+        Size add(const BarrierOption& option);
+        // named parameters
+        MCPortfolioPricer& withSteps(Size steps);
+        MCPortfolioPricer& withStepsPerYear(Size steps);
+        MCPortfolioPricer& withBrownianBridge(bool b = true);
+        MCPortfolioPricer& withAntitheticVariate(bool b = true);
+        MCPortfolioPricer& withSamples(Size samples);
+        MCPortfolioPricer& withAbsoluteTolerance(Real tolerance);
+        MCPortfolioPricer& withMaxSamples(Size samples);
+        MCPortfolioPricer& withBias(bool b = true);
+        MCPortfolioPricer& withSeed(BigNatural seed);
+        MCPortfolioPricer& withConstantParameters(bool b = true);
+        MCPortfolioPricer& withThreads(Size n);
+        //! simulates the portfolio and returns one result per instrument
+        std::vector<PortfolioResult> calculate() const;
+        Size size() const { return instruments_.size(); }
+      private:
+        enum Kind { Vanilla, AverageStrike, KnockBarrier };
+        struct Position {
+            Kind kind;
+            ext::shared_ptr<PlainVanillaPayoff> payoff;
+            Date exerciseDate;
+            // Asian
+            std::vector<Date> fixingDates;
+            Real runningSum;
+            Size pastFixings;
+            // barrier
+            Barrier::Type barrierType;
+            Real barrier, rebate;
+        };
+        Position makeInstrument(Kind kind, const Option::arguments& args) const;
+        bool expired(const Position& instrument) const;
+        TimeGrid timeGrid() const;
+        ext::shared_ptr<StochasticProcess1D> simulatedProcess(const TimeGrid& grid) const;
+        std::vector<ext::shared_ptr<PathPricer<Path> > >
+        makePathPricers(const TimeGrid& grid,
+                        const ext::shared_ptr<StochasticProcess1D>& process,
+                        BigNatural uniformSeed) const;
+
+        ext::shared_ptr<GeneralizedBlackScholesProcess> process_;
+        std::vector<Position> instruments_;
+        bool brownianBridge_ = is_low_discrepancy<RNG>::value;
+        bool antithetic_ = false, biased_ = false;
+        Size steps_, stepsPerYear_, samples_, maxSamples_;
+        Real tolerance_;
+        BigNatural seed_ = 0;
+        bool constantParameters_ = false;
+        Size threads_ = 1;
+        mutable ConstantProcessCache constantProcessCache_;
+    };
+
+
+    // definitions
+
+    inline Real BarrierNodePathPricer::operator()(const Path& path) const {
+        static Size null = Null<Size>();
+        Size n = discounts_.size();
+        QL_REQUIRE(n > 1 && n <= path.length(), "wrong barrier node");
+
+        bool down = (barrierType_ == Barrier::DownIn ||
+                     barrierType_ == Barrier::DownOut);
+        bool knockIn = (barrierType_ == Barrier::DownIn ||
+                        barrierType_ == Barrier::UpIn);
+        const TimeGrid& timeGrid = path.timeGrid();
+
+        Size knockNode = null;
+        if (isBiased_) {
+            for (Size i = 1; i < n && knockNode == null; ++i) {
+                if (down ? path[i] <= barrier_ : path[i] >= barrier_)
+                    knockNode = i;
+            }
+        } else {
+            const std::vector<Real>& u = sequenceGen_.nextSequence().value;
+            for (Size i = 0; i < n - 1 && knockNode == null; ++i) {
+                Real asset_price = path[i];
+                Volatility vol = diffProcess_->diffusion(timeGrid[i], asset_price);
+                Real x = std::log(path[i + 1] / asset_price);
+                Real v = 2.0 * vol * vol * timeGrid.dt(i);
+                Real y = down ?
+                    0.5 * (x - std::sqrt(x * x - v * std::log(u[i]))) :
+                    0.5 * (x + std::sqrt(x * x - v * std::log(1.0 - u[i])));
+                y = asset_price * std::exp(y);
+                if (down ? y <= barrier_ : y >= barrier_)
+                    knockNode = i + 1;
+            }
+        }
+
+        bool knocked = (knockNode != null);
+        if (knocked == knockIn)
+            return payoff_(path[n - 1]) * discounts_.back();
+        else if (knockIn)
+            return rebate_ * discounts_.back();
+        else
+            return rebate_ * discounts_[knockNode];
+    }
+
+    template <class RNG, class S>
+    inline void PortfolioMonteCarloModel<RNG,S>::addSamples(Size samples) {
+        Size n = pathPricers_.size();
+        for (Size j = 0; j < samples; ++j) {
+            const typename path_generator_type::sample_type& path =
+                pathGenerator_->next();
+            // next() and antithetic() share their storage
+            for (Size k = 0; k < n; ++k)
+                values_[k] = (*pathPricers_[k])(path.value);
+            if (antitheticVariate_) {
+                const typename path_generator_type::sample_type& atPath =
+                    pathGenerator_->antithetic();
+                for (Size k = 0; k < n; ++k)
+                    values_[k] = (values_[k] + (*pathPricers_[k])(atPath.value)) / 2.0;
+            }
+            for (Size k = 0; k < n; ++k)
+                sampleAccumulator_[k].add(values_[k], path.weight);
+        }
+    }
+
+    template <class RNG, class S>
+    inline MCPortfolioPricer<RNG,S>::MCPortfolioPricer(
+                     ext::shared_ptr<GeneralizedBlackScholesProcess> process)
+    : process_(std::move(process)), steps_(Null<Size>()),
+      stepsPerYear_(Null<Size>()), samples_(Null<Size>()),
+      maxSamples_(Null<Size>()), tolerance_(Null<Real>()) {
+        // l'erreur d'un QMC randomisé vient de l'écart entre brouillages
+        // (simulateModels), pas de la variance des points mis en commun
+        static_assert(!is_randomized_qmc<RNG>::value,
+                      "randomized QMC not supported by the portfolio pricer");
+    }
+
+    template <class RNG, class S>
+    inline typename MCPortfolioPricer<RNG,S>::Position
+    MCPortfolioPricer<RNG,S>::makeInstrument(Kind kind,
+                                             const Option::arguments& args) const {
+        Position instrument;
+        instrument.kind = kind;
+        instrument.payoff =
+            ext::dynamic_pointer_cast<PlainVanillaPayoff>(args.payoff);
+        QL_REQUIRE(instrument.payoff, "non-plain payoff given");
+        QL_REQUIRE(args.exercise &&
+                   args.exercise->type() == Exercise::European,
+                   "not an European option");
+        instrument.exerciseDate = args.exercise->lastDate();
+        instrument.runningSum = 0.0;
+        instrument.pastFixings = 0;
+        instrument.barrierType = Barrier::DownIn;
+        instrument.barrier = instrument.rebate = 0.0;
+        return instrument;
+    }
+
+    template <class RNG, class S>
+    inline Size MCPortfolioPricer<RNG,S>::add(const EuropeanOption& option) {
+        Option::arguments args;
+        option.setupArguments(&args);
+        instruments_.push_back(makeInstrument(Vanilla, args));
+        return instruments_.size() - 1;
+    }
+
+    template <class RNG, class S>
+    inline Size
+    MCPortfolioPricer<RNG,S>::add(const DiscreteAveragingAsianOption& option) {
+        DiscreteAveragingAsianOption::arguments args;
+        option.setupArguments(&args);
+        QL_REQUIRE(args.averageType == Average::Arithmetic,
+                   "arithmetic average required");
+        Position instrument = makeInstrument(AverageStrike, args);
+        instrument.fixingDates = args.fixingDates;
+        instrument.runningSum = args.runningAccumulator;
+        instrument.pastFixings = args.pastFixings;
+        instruments_.push_back(instrument);
+        return instruments_.size() - 1;
+    }
+
+    template <class RNG, class S>
+    inline Size MCPortfolioPricer<RNG,S>::add(const BarrierOption& option) {
+        BarrierOption::arguments args;
+        option.setupArguments(&args);
+        Position instrument = makeInstrument(KnockBarrier, args);
+        instrument.barrierType = args.barrierType;
+        instrument.barrier = args.barrier;
+        instrument.rebate = args.rebate;
+        instruments_.push_back(instrument);
+        return instruments_.size() - 1;
+    }
+
+    template <class RNG, class S>
+    inline bool MCPortfolioPricer<RNG,S>::expired(const Position& instrument) const {
+        return process_->time(instrument.exerciseDate) <= 0.0;
+    }
+
+    template <class RNG, class S>
+    inline TimeGrid MCPortfolioPricer<RNG,S>::timeGrid() const {
+        // dates des seules options vivantes
+        std::vector<Time> times;
+        for (const auto& instrument : instruments_) {
+            if (expired(instrument))
+                continue;
+            times.push_back(process_->time(instrument.exerciseDate));
+            for (const auto& d : instrument.fixingDates) {
+                Time t = process_->time(d);
+                if (t >= 0.0)
+                    times.push_back(t);
+            }
+        }
+        QL_REQUIRE(!times.empty(), "all options expired");
+        Time last = *std::max_element(times.begin(), times.end());
+        Size steps = steps_;
+        if (steps == Null<Size>())
+            steps = std::max<Size>(static_cast<Size>(stepsPerYear_ * last), 1);
+        return TimeGrid(times.begin(), times.end(), steps);
+    }
+
+    template <class RNG, class S>
+    inline ext::shared_ptr<StochasticProcess1D>
+    MCPortfolioPricer<RNG,S>::simulatedProcess(const TimeGrid& grid) const {
+        if (!constantParameters_)
+            return process_;
+        return constantProcessCache_.getPiecewise(process_, grid, process_->x0());
+    }
+
+    template <class RNG, class S>
+    inline std::vector<ext::shared_ptr<PathPricer<Path> > >
+    MCPortfolioPricer<RNG,S>::makePathPricers(
+                         const TimeGrid& grid,
+                         const ext::shared_ptr<StochasticProcess1D>& process,
+                         BigNatural uniformSeed) const {
+        std::vector<ext::shared_ptr<PathPricer<Path> > > pricers;
+        for (Size k = 0; k < instruments_.size(); ++k) {
+            const Position& instrument = instruments_[k];
+            if (expired(instrument))
+                continue;
+            Time maturity = process_->time(instrument.exerciseDate);
+            Size exerciseNode = grid.index(maturity);
+            DiscountFactor discount = process_->riskFreeRate()->discount(maturity);
+            Option::Type type = instrument.payoff->optionType();
+
+            switch (instrument.kind) {
+              case Vanilla:
+                pricers.push_back(ext::make_shared<EuropeanNodePathPricer>(
+                    type, instrument.payoff->strike(), discount, exerciseNode));
+                break;
+              case AverageStrike: {
+                  std::vector<Size> fixingNodes;
+                  for (const auto& d : instrument.fixingDates) {
+                      Time t = process_->time(d);
+                      if (t >= 0.0)
+                          fixingNodes.push_back(grid.index(t));
+                  }
+                  pricers.push_back(ext::make_shared<ArithmeticASONodePathPricer>(
+                      type, discount, instrument.runningSum,
+                      instrument.pastFixings, fixingNodes));
+                  break;
+              }
+              case KnockBarrier: {
+                  Real spot = process_->x0();
+                  bool down = (instrument.barrierType == Barrier::DownIn ||
+                               instrument.barrierType == Barrier::DownOut);
+                  QL_REQUIRE(down ? spot >= instrument.barrier
+                                  : spot <= instrument.barrier,
+                             "barrier touched");
+                  std::vector<DiscountFactor> discounts(exerciseNode + 1);
+                  for (Size i = 0; i <= exerciseNode; ++i)
+                      discounts[i] = process_->riskFreeRate()->discount(grid[i]);
+                  // a separate uniform stream for each barrier option
+                  PseudoRandom::ursg_type sequenceGen(
+                      grid.size() - 1,
+                      PseudoRandom::urng_type(deriveSeed(uniformSeed, k)));
+                  pricers.push_back(ext::make_shared<BarrierNodePathPricer>(
+                      instrument.barrierType, instrument.barrier,
+                      instrument.rebate, type, instrument.payoff->strike(),
+                      discounts, process, biased_, sequenceGen));
+                  break;
+              }
+              default:
+                QL_FAIL("unknown instrument");
+            }
+        }
+        return pricers;
+    }
+
+    template <class RNG, class S>
+    inline std::vector<PortfolioResult>
+    MCPortfolioPricer<RNG,S>::calculate() const {
+        QL_REQUIRE(!instruments_.empty(), "no instruments given");
+        QL_REQUIRE(steps_ != Null<Size>() || stepsPerYear_ != Null<Size>(),
+                   "number of steps not given");
+        QL_REQUIRE(steps_ == Null<Size>() || stepsPerYear_ == Null<Size>(),
+                   "number of steps overspecified");
+
+        // options échues : valeur et erreur nulles, sans simulation
+        std::vector<PortfolioResult> results(instruments_.size(),
+                                             PortfolioResult{0.0, 0.0});
+        if (std::all_of(instruments_.begin(), instruments_.end(),
+                        [this](const Position& p) { return expired(p); }))
+            return results;
+
+        TimeGrid grid = timeGrid();
+        ext::shared_ptr<StochasticProcess1D> process = simulatedProcess(grid);
+
+        // un générateur (graine dérivée) et des pricers par thread ; le
+        // process par intervalle est copié (intervalle courant mutable).
+        // Les uniformes des barrières ont leurs propres graines, dérivées
+        // elles aussi de seed_ après celles des chemins.
+        auto makeModel = [&](Size i) {
+            ext::shared_ptr<StochasticProcess1D> p = process;
+            if (constantParameters_ && threads_ > 1)
+                p = ext::make_shared<PiecewiseConstantBlackScholesProcess>(
+                    *ext::dynamic_pointer_cast<PiecewiseConstantBlackScholesProcess>(process));
+            typename RNG::rsg_type generator =
+                RNG::make_sequence_generator(grid.size() - 1,
+                                             deriveSeed(seed_, i));
+            return ext::make_shared<PortfolioMonteCarloModel<RNG,S> >(
+                ext::make_shared<PathGenerator<typename RNG::rsg_type> >(
+                    p, grid, generator, brownianBridge_),
+                makePathPricers(grid, p, deriveSeed(seed_, threads_ + i)),
+                antithetic_);
+        };
+        PortfolioStatistics<S> stats =
+            simulateInParallel(threads_, makeModel,
+                               tolerance_, samples_, maxSamples_);
+
+        // les accumulateurs suivent l'ordre des options vivantes
+        for (Size k = 0, j = 0; k < results.size(); ++k) {
+            if (expired(instruments_[k]))
+                continue;
+            results[k].value = stats[j].mean();
+            results[k].errorEstimate =
+                RNG::allowsErrorEstimate ? stats[j].errorEstimate()
+                                         : Null<Real>();
+            ++j;
+        }
+        return results;
+    }
+
+    template <class RNG, class S>
+    inline MCPortfolioPricer<RNG,S>&
+    MCPortfolioPricer<RNG,S>::withSteps(Size steps) {
+        steps_ = steps;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MCPortfolioPricer<RNG,S>&
+    MCPortfolioPricer<RNG,S>::withStepsPerYear(Size steps) {
+        stepsPerYear_ = steps;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MCPortfolioPricer<RNG,S>&
+    MCPortfolioPricer<RNG,S>::withBrownianBridge(bool b) {
+        brownianBridge_ = b;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MCPortfolioPricer<RNG,S>&
+    MCPortfolioPricer<RNG,S>::withAntitheticVariate(bool b) {
+        antithetic_ = b;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MCPortfolioPricer<RNG,S>&
+    MCPortfolioPricer<RNG,S>::withSamples(Size samples) {
+        QL_REQUIRE(tolerance_ == Null<Real>(), "tolerance already set");
+        samples_ = samples;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MCPortfolioPricer<RNG,S>&
+    MCPortfolioPricer<RNG,S>::withAbsoluteTolerance(Real tolerance) {
+        QL_REQUIRE(samples_ == Null<Size>(),
+                   "number of samples already set");
+        QL_REQUIRE(RNG::allowsErrorEstimate,
+                   "chosen random generator policy "
+                   "does not allow an error estimate");
+        tolerance_ = tolerance;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MCPortfolioPricer<RNG,S>&
+    MCPortfolioPricer<RNG,S>::withMaxSamples(Size samples) {
+        maxSamples_ = samples;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MCPortfolioPricer<RNG,S>&
+    MCPortfolioPricer<RNG,S>::withBias(bool b) {
+        biased_ = b;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MCPortfolioPricer<RNG,S>&
+    MCPortfolioPricer<RNG,S>::withSeed(BigNatural seed) {
+        seed_ = seed;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MCPortfolioPricer<RNG,S>&
+    MCPortfolioPricer<RNG,S>::withConstantParameters(bool b) {
+        constantParameters_ = b;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MCPortfolioPricer<RNG,S>&
+    MCPortfolioPricer<RNG,S>::withThreads(Size n) {
+        QL_REQUIRE(n > 0, "at least one thread required");
+        checkThreadsForGenerator<RNG>(n);
+        threads_ = n;
+        return *this;
+    }
+
+}
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef QL_MCPROFILER_HPP
+#define QL_MCPROFILER_HPP
+
+#include <ql/pricingengine.hpp>
+#include <ql/types.hpp>
+#include <array>
+#include <chrono>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace QuantLib {
+
+    //------------------------------------------------------------------------
+    // Per-phase instrumentation of the _2 engines.
+    //   - opt-in: the timers and counters are only compiled in when
+    //     QL_MC_PROFILE is defined for the whole program (e.g. with
+    //     "make MCFLAGS=-DQL_MC_PROFILE"); otherwise the macros below
+    //     expand to nothing and the sampling loops pay nothing
+    //   - each model fills its own McProfile, so that threads never share
+    //     one; the profiles are summed once sampling is over
+    //------------------------------------------------------------------------
+
+    //! Timers and counters of a Monte Carlo run
+    struct McProfile {
+        enum Phase {
+            Extraction,        //!< constant-parameter extraction from the curves
+            Setup,             //!< everything before sampling, extraction included
+            RandomNumbers,     //!< drawing the normals (batch and terminal models)
+            PathConstruction,  //!< building the paths; includes the normals
+                               //!< for paths coming from PathGenerator
+            Pricing,           //!< path pricers, control variate included
+            Accumulation,      //!< adding the samples to the statistics
+            Phases
+        };
+        std::array<long long, Phases> nanoseconds = {};
+        Size paths = 0;
+        Size randomDraws = 0;
+        //! path steps simulated by PathMonteCarloModel
+        /*! One step is one evolve() call for PathGenerator paths, but the
+            process may query several term structures in it: this is not a
+            count of the calls made to the curves.
+        */
+        Size steps = 0;
+        //! constant processes built from the curves (cache misses)
+        Size extractions = 0;
+
+        McProfile& operator+=(const McProfile& other) {
+            for (Size i = 0; i < Phases; ++i)
+                nanoseconds[i] += other.nanoseconds[i];
+            paths += other.paths;
+            randomDraws += other.randomDraws;
+            steps += other.steps;
+            extractions += other.extractions;
+            return *this;
+        }
+
+        //! writes the timers (in ns) and counters to an engine's results
+        void addTo(std::map<std::string, ext::any>& results) const {
+            static const char* names[Phases] = {
+                "extractionTimeNs", "setupTimeNs", "randomNumberTimeNs",
+                "pathConstructionTimeNs", "pricingTimeNs", "accumulationTimeNs"
+            };
+            for (Size i = 0; i < Phases; ++i)
+                results[names[i]] = nanoseconds[i];
+            results["paths"] = paths;
+            results["randomDraws"] = randomDraws;
+            // path steps, not calls to the curves (see steps)
+            results["steps"] = steps;
+            results["extractions"] = extractions;
+        }
+    };
+
+    //! adds the time elapsed during its lifetime to a phase of a profile
+    class McPhaseTimer {
+      public:
+        typedef std::chrono::steady_clock clock;
+        McPhaseTimer(McProfile& profile, McProfile::Phase phase)
+        : profile_(profile), phase_(phase), start_(clock::now()) {}
+        ~McPhaseTimer() {
+            profile_.nanoseconds[phase_] +=
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    clock::now() - start_).count();
+        }
+        McPhaseTimer(const McPhaseTimer&) = delete;
+        McPhaseTimer& operator=(const McPhaseTimer&) = delete;
+      private:
+        McProfile& profile_;
+        McProfile::Phase phase_;
+        clock::time_point start_;
+    };
+
+    //! Profile of a whole calculate() call
+    /*! Built when the calculation starts; finish() adds the extraction
+        profile to the sampling one, charges to the setup phase whatever
+        was not spent sampling and writes the result to the engine's
+        additional results.
+    */
+    class McCalculationProfile {
+      public:
+        typedef std::chrono::steady_clock clock;
+        McCalculationProfile() : start_(clock::now()) {}
+        void finish(McProfile profile,
+                    const McProfile& extraction,
+                    Real samplingTime,
+                    std::map<std::string, ext::any>& results) const {
+            long long total =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    clock::now() - start_).count();
+            profile += extraction;
+            profile.nanoseconds[McProfile::Setup] +=
+                total - static_cast<long long>(samplingTime * 1.0e9);
+            profile.addTo(results);
+        }
+      private:
+        clock::time_point start_;
+    };
+
+    namespace detail {
+
+        template <class M, class = void>
+        struct has_profile : std::false_type {};
+
+        template <class M>
+        struct has_profile<M, decltype(void(std::declval<const M&>().profile()))>
+        : std::true_type {};
+
+    }
+
+    //! profile of a model, or an empty one if the model keeps none
+    template <class Model>
+    inline McProfile profileOf(const Model& model) {
+        if constexpr (detail::has_profile<Model>::value)
+            return model.profile();
+        else
+            return McProfile();
+    }
+
+} // namespace QuantLib
+
+#if defined(QL_MC_PROFILE)
+//! times the rest of the enclosing block (one per block)
+#  define QL_MC_PROFILE_PHASE(profile, phase) \
+    QuantLib::McPhaseTimer ql_mc_phase_timer((profile), QuantLib::McProfile::phase)
+//! compiles the statement only when profiling
+#  define QL_MC_PROFILE_ONLY(statement) statement
+#else
+#  define QL_MC_PROFILE_PHASE(profile, phase)
+#  define QL_MC_PROFILE_ONLY(statement)
+#endif
+
+#endif
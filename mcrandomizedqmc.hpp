@@ -0,0 +1,208 @@
+#ifndef QL_MCRANDOMIZEDQMC_HPP
+#define QL_MCRANDOMIZEDQMC_HPP
+
+#include <ql/math/randomnumbers/burley2020sobolrsg.hpp>
+#include <ql/math/randomnumbers/rngtraits.hpp>
+#include <ql/math/randomnumbers/seedgenerator.hpp>
+#include <ql/utilities/null.hpp>
+#include <cmath>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "mcparallel.hpp"
+
+namespace QuantLib {
+
+    //! Scrambled Sobol traits for randomized quasi-Monte Carlo
+    /*! Each seed gives an independent scramble (Burley 2020) of the Sobol
+        sequence.  The _2 engines run several scrambles and estimate the
+        error from the spread of their means, hence allowsErrorEstimate.
+    */
+    template <class IC>
+    struct GenericScrambledSobol {
+        typedef Burley2020SobolRsg ursg_type;
+        typedef InverseCumulativeRsg<ursg_type, IC> rsg_type;
+        enum { allowsErrorEstimate = 1 };
+        static rsg_type make_sequence_generator(Size dimension,
+                                                BigNatural seed) {
+            if (seed == 0)
+                seed = SeedGenerator::instance().get();
+            ursg_type g(dimension, 42, SobolRsg::JoeKuoD7, seed);
+            return rsg_type(g);
+        }
+    };
+
+    typedef GenericScrambledSobol<InverseCumulativeNormal> ScrambledSobol;
+
+    //! true for low-discrepancy traits (Brownian bridge on by default)
+    template <class RNG>
+    struct is_low_discrepancy : std::false_type {};
+
+    template <class URSG, class IC>
+    struct is_low_discrepancy<GenericLowDiscrepancy<URSG, IC> >
+    : std::true_type {};
+
+    template <class IC>
+    struct is_low_discrepancy<GenericScrambledSobol<IC> > : std::true_type {};
+
+    //! true for traits simulated as independent randomized replicates
+    template <class RNG>
+    struct is_randomized_qmc : std::false_type {};
+
+    template <class IC>
+    struct is_randomized_qmc<GenericScrambledSobol<IC> > : std::true_type {};
+
+    //! checks that a generator policy can be split across threads
+    /*! Sobol points do not depend on the seed unless scrambled: each thread
+        would simulate the same paths.
+    */
+    template <class RNG>
+    inline void checkThreadsForGenerator(Size threads) {
+        QL_REQUIRE(threads == 1 || !is_low_discrepancy<RNG>::value ||
+                   is_randomized_qmc<RNG>::value,
+                   "low-discrepancy sequences cannot be split across "
+                   "threads; use ScrambledSobol");
+    }
+
+
+    //! Mean and error of independent replicates of an estimator
+    /*! The error estimate is the standard error of the replicate means,
+        which is the relevant one for (randomized) quasi-Monte Carlo.
+    */
+    class ReplicateStatistics {
+      public:
+        void reset() { means_.clear(); samples_.clear(); }
+        void add(Real mean, Size samples) {
+            means_.push_back(mean);
+            samples_.push_back(samples);
+        }
+        Size replicates() const { return means_.size(); }
+        Size samples() const {
+            Size n = 0;
+            for (Size s : samples_)
+                n += s;
+            return n;
+        }
+        Real mean() const {
+            QL_REQUIRE(samples() > 0, "empty sample set");
+            Real sum = 0.0;
+            for (Size i = 0; i < means_.size(); ++i)
+                sum += means_[i] * samples_[i];
+            return sum / samples();
+        }
+        Real errorEstimate() const {
+            return replicateErrorEstimate(means_);
+        }
+      private:
+        std::vector<Real> means_;
+        std::vector<Size> samples_;
+    };
+
+    //! Runs independent replicates (e.g., scrambles) of a Monte Carlo model
+    /*! Samples are split evenly across the replicates; replicates are
+        spread over the given number of threads.
+    */
+    template <class Model>
+    class ReplicatedMonteCarloModel {
+      public:
+        typedef ReplicateStatistics stats_type;
+
+        ReplicatedMonteCarloModel(std::vector<ext::shared_ptr<Model> > replicates,
+                                  Size threads)
+        : replicates_(std::move(replicates)), threads_(threads) {
+            QL_REQUIRE(replicates_.size() > 1,
+                       "at least two replicates required");
+        }
+        void addSamples(Size samples) {
+            Size n = replicates_.size();
+            runConcurrently(n, threads_, [&](Size i) {
+                replicates_[i]->addSamples(samples / n + (i < samples % n ? 1 : 0));
+            });
+            sampleAccumulator_.reset();
+            for (const auto& m : replicates_) {
+                if (m->sampleAccumulator().samples() > 0)
+                    sampleAccumulator_.add(m->sampleAccumulator().mean(),
+                                           m->sampleAccumulator().samples());
+            }
+        }
+        const stats_type& sampleAccumulator() const {
+            return sampleAccumulator_;
+        }
+      private:
+        std::vector<ext::shared_ptr<Model> > replicates_;
+        Size threads_;
+        stats_type sampleAccumulator_;
+    };
+
+    //------------------------------------------------------------------------
+    // simulateModels<RNG>(threads, replicates, makeModel, ...) :
+    //   - randomized QMC: makeModel(i) builds the i-th scramble (seed
+    //     deriveSeed(seed, i)); the error comes from the replicate means
+    //   - otherwise: simulateInParallel(threads, makeModel, ...)
+    //   - returns (mean, error estimate); the error is Null<Real>() if the
+    //     generator policy does not allow one, and comes from the group
+    //     averages if the models draw dependent groups of paths
+    //   - report, if given, receives the samples used, the sampling time
+    //     and the heap allocations, as in simulateInParallel
+    //------------------------------------------------------------------------
+    template <class RNG, class ModelFactory>
+    inline std::pair<Real, Real> simulateModels(Size threads,
+                                                Size replicates,
+                                                const ModelFactory& makeModel,
+                                                Real requiredTolerance,
+                                                Size requiredSamples,
+                                                Size maxSamples,
+                                                SamplingReport* report = nullptr) {
+        if constexpr (is_randomized_qmc<RNG>::value) {
+            typedef typename std::decay<decltype(*makeModel(Size(0)))>::type
+                model_type;
+            typedef AllocationCountingModel<model_type> counting_model_type;
+            std::vector<ext::shared_ptr<counting_model_type> > models;
+            models.reserve(replicates);
+            for (Size i = 0; i < replicates; ++i)
+                models.push_back(
+                    ext::make_shared<counting_model_type>(makeModel(i)));
+            // same lazy-initialization warm-up as simulateInParallel
+            if (threads > 1)
+                makeModel(replicates)->addSamples(1);
+
+            ReplicatedMonteCarloModel<counting_model_type> model(models,
+                                                                 threads);
+            SamplingReport r = simulateSamples(model, requiredTolerance,
+                                               requiredSamples, maxSamples);
+            if (report != nullptr) {
+                *report = r;
+                report->sampleAllocations = countedAllocations(models);
+                report->profile = countedProfile(models);
+                report->greeks = countedGreeks(models);
+                report->scenarios = countedScenarios(models);
+                // the errors of the greeks and scenarios come from the
+                // replicates
+                for (const auto& m : models) {
+                    report->replicateGreeks.push_back(m->greeks());
+                    report->replicateScenarios.push_back(m->scenarios());
+                }
+            }
+            return std::make_pair(model.sampleAccumulator().mean(),
+                                  model.sampleAccumulator().errorEstimate());
+        } else {
+            // the group averages are needed for the error estimate
+            SamplingReport r;
+            auto stats = simulateInParallel(threads, makeModel,
+                                            requiredTolerance,
+                                            requiredSamples,
+                                            maxSamples,
+                                            &r);
+            if (report != nullptr)
+                *report = r;
+            return std::make_pair(stats.mean(),
+                                  RNG::allowsErrorEstimate ?
+                                      r.errorEstimate(stats) :
+                                      Real(Null<Real>()));
+        }
+    }
+
+} // namespace QuantLib
+
+#endif
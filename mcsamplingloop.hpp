@@ -0,0 +1,241 @@
+#ifndef QL_MCSAMPLINGLOOP_HPP
+#define QL_MCSAMPLINGLOOP_HPP
+
+#include <ql/errors.hpp>
+#include <ql/types.hpp>
+#include <ql/utilities/null.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "batchpathgenerator.hpp"
+#include "mcgreeks.hpp"
+#include "mcprofiler.hpp"
+#include "mcscenarios.hpp"
+
+namespace QuantLib {
+
+    //! standard error of the mean of independent replicate means
+    /*! The relevant error for (randomized) quasi-Monte Carlo, where the
+        points of a replicate are not independent.
+    */
+    inline Real replicateErrorEstimate(const std::vector<Real>& means) {
+        Size r = means.size();
+        QL_REQUIRE(r > 1, "at least two replicates required");
+        Real average = 0.0;
+        for (Real m : means)
+            average += m;
+        average /= r;
+        Real variance = 0.0;
+        for (Real m : means)
+            variance += (m - average) * (m - average);
+        return std::sqrt(variance / (r * (r - 1.0)));
+    }
+
+    //! What a call to simulateSamples() did
+    struct SamplingReport {
+        //! samples in the accumulator at the end of the run
+        Size samples = 0;
+        //! calls to addSamples(), i.e., error checks in tolerance mode
+        Size batches = 0;
+        //! wall time spent sampling, in seconds (time to tolerance)
+        Real elapsedTime = 0.0;
+        //! heap allocations made while sampling, see AllocationCountingModel
+        Size sampleAllocations = 0;
+        //! timers and counters of the models (QL_MC_PROFILE only)
+        McProfile profile;
+        //! greeks computed along with the value, see GreeksMonteCarloModel
+        GreekStatistics greeks;
+        //! bumped scenarios, see ScenarioMonteCarloModel
+        std::vector<StreamingStatistics> scenarios;
+        //! averages of dependent groups of paths, see BatchSampling
+        StreamingStatistics groupStatistics;
+        //! samples of each level, coarsest first, see simulateMultilevel
+        std::vector<Size> levelSamples;
+        //! greeks of each replicate, with randomized QMC only (see
+        //! simulateModels); greeks pools them for the means
+        std::vector<GreekStatistics> replicateGreeks;
+        //! scenarios of each replicate, likewise
+        std::vector<std::vector<StreamingStatistics> > replicateScenarios;
+
+        //! error of the mean of S, from the groups if the paths are not
+        //! independent
+        /*! With a single group the error is unknown and Null<Real>() is
+            returned: the per-path error of dependent paths is meaningless.
+        */
+        template <class S>
+        Real errorEstimate(const S& stats) const {
+            if (groupStatistics.samples() == 0)
+                return stats.errorEstimate();
+            return groupStatistics.samples() > 1 ?
+                groupStatistics.errorEstimate() : Real(Null<Real>());
+        }
+
+        //! writes the errors of the greeks to an engine's results
+        /*! From the spread of the replicate means with randomized QMC, as
+            for the value; from the pooled samples otherwise.
+        */
+        void addGreekErrorsTo(std::map<std::string, ext::any>& results) const {
+            if (replicateGreeks.empty()) {
+                greeks.addErrorsTo(results);
+                return;
+            }
+            std::vector<Real> delta, gamma, vega;
+            for (const auto& g : replicateGreeks) {
+                if (g.empty())
+                    continue;
+                delta.push_back(g.delta.mean());
+                gamma.push_back(g.gamma.mean());
+                vega.push_back(g.vega.mean());
+            }
+            results["deltaErrorEstimate"] = replicateErrorEstimate(delta);
+            results["gammaErrorEstimate"] = replicateErrorEstimate(gamma);
+            results["vegaErrorEstimate"] = replicateErrorEstimate(vega);
+        }
+
+        //! errors of the scenario values, same rule as the greeks
+        std::vector<Real> scenarioErrorEstimates() const {
+            std::vector<Real> errors(scenarios.size());
+            for (Size k = 0; k < scenarios.size(); ++k) {
+                if (replicateScenarios.empty()) {
+                    errors[k] = scenarios[k].errorEstimate();
+                    continue;
+                }
+                std::vector<Real> means;
+                for (const auto& r : replicateScenarios)
+                    if (k < r.size() && r[k].samples() > 0)
+                        means.push_back(r[k].mean());
+                errors[k] = replicateErrorEstimate(means);
+            }
+            return errors;
+        }
+    };
+
+    //! dependent groups of paths drawn by a model, 0 if its paths are
+    //! independent
+    template <class Model>
+    inline Size sampleGroups(const Model& model) {
+        if constexpr (detail::has_group_statistics<Model>::value)
+            return model.groupStatistics().samples();
+        else
+            return 0;
+    }
+
+    //! error of the mean of a model's samples
+    /*! From the group averages when the model draws dependent groups of
+        paths (moment matching, stratification), otherwise from its
+        accumulator.  Dependent paths never fall back to the per-path
+        error: with a single group the error is infinite.
+    */
+    template <class Model>
+    inline Real sampleErrorEstimate(const Model& model) {
+        if constexpr (detail::has_group_statistics<Model>::value) {
+            Size groups = model.groupStatistics().samples();
+            if (groups > 1)
+                return model.groupStatistics().errorEstimate();
+            else if (groups == 1)
+                return QL_MAX_REAL;
+        }
+        return model.sampleAccumulator().errorEstimate();
+    }
+
+    //------------------------------------------------------------------------
+    // simulateSamples(model, ...) :
+    //   - fixed number of samples: same as McSimulation::calculate
+    //   - tolerance: batches are added until the pooled error estimate is
+    //     below tolerance, the error being checked after each batch.  The
+    //     next batch is the estimated number of missing samples,
+    //     N (error/tolerance)^2 - N, but never more than the samples
+    //     already drawn, so the total at most doubles between two checks
+    //     and a noisy early estimate cannot overshoot the target by much
+    //   - the model must provide addSamples(Size) and sampleAccumulator(),
+    //     like MonteCarloModel does; this lets the engines plug in
+    //     simulations that do not go through PathGenerator, and parallel
+    //     models that draw each batch on several threads
+    //   - the error is sampleErrorEstimate(model), which accounts for
+    //     dependent groups of paths; it is only trusted once there are at
+    //     least minGroups groups, the spread of a few group averages being
+    //     too noisy: until then, the next batch is the missing groups
+    //   - returns the samples used and the time taken
+    //------------------------------------------------------------------------
+    template <class Model>
+    inline SamplingReport simulateSamples(Model& model,
+                                          Real requiredTolerance,
+                                          Size requiredSamples,
+                                          Size maxSamples,
+                                          Size minSamples = 1023,
+                                          Size minGroups = 30) {
+        QL_REQUIRE(requiredTolerance != Null<Real>() ||
+                   requiredSamples != Null<Size>(),
+                   "neither tolerance nor number of samples set");
+
+        SamplingReport report;
+        auto start = std::chrono::steady_clock::now();
+        auto addSamples = [&](Size samples) {
+            model.addSamples(samples);
+            ++report.batches;
+        };
+        auto finish = [&]() {
+            report.samples = model.sampleAccumulator().samples();
+            report.elapsedTime = std::chrono::duration<Real>(
+                std::chrono::steady_clock::now() - start).count();
+            return report;
+        };
+
+        if (requiredTolerance == Null<Real>()) {
+            Size sampleNumber = model.sampleAccumulator().samples();
+            QL_REQUIRE(requiredSamples >= sampleNumber,
+                       "number of already simulated samples greater than "
+                       "requested samples");
+            addSamples(requiredSamples - sampleNumber);
+            return finish();
+        }
+
+        if (maxSamples == Null<Size>())
+            maxSamples = QL_MAX_INTEGER;
+
+        Size sampleNumber = model.sampleAccumulator().samples();
+        if (sampleNumber < minSamples) {
+            addSamples(minSamples - sampleNumber);
+            sampleNumber = model.sampleAccumulator().samples();
+        }
+
+        Real error = sampleErrorEstimate(model);
+        Size groups = sampleGroups(model);
+        auto tooFewGroups = [&]() { return groups > 0 && groups < minGroups; };
+        while (error > requiredTolerance || tooFewGroups()) {
+            QL_REQUIRE(sampleNumber < maxSamples,
+                       "max number of samples (" << maxSamples
+                       << ") reached, while error (" << error
+                       << ") is still above tolerance ("
+                       << requiredTolerance << ") or with only "
+                       << groups << " groups of paths");
+
+            Size nextBatch;
+            if (tooFewGroups()) {
+                // the missing groups, at the current group size
+                Size groupSize = model.sampleAccumulator().samples() / groups;
+                nextBatch = (minGroups - groups) * std::max<Size>(groupSize, 1);
+            } else {
+                Real order = error * error / requiredTolerance / requiredTolerance;
+                Real missing = static_cast<Real>(sampleNumber) * (order - 1.0);
+                nextBatch = Size(std::min<Real>(
+                    std::max<Real>(missing, static_cast<Real>(minSamples)),
+                    static_cast<Real>(std::max(sampleNumber, minSamples))));
+            }
+            nextBatch = std::min(nextBatch, maxSamples - sampleNumber);
+
+            sampleNumber += nextBatch;
+            addSamples(nextBatch);
+            error = sampleErrorEstimate(model);
+            groups = sampleGroups(model);
+        }
+        return finish();
+    }
+
+} // namespace QuantLib
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef QL_MCSCENARIOS_HPP
+#define QL_MCSCENARIOS_HPP
+
+#include <ql/methods/montecarlo/brownianbridge.hpp>
+#include <ql/methods/montecarlo/path.hpp>
+#include <ql/methods/montecarlo/pathpricer.hpp>
+#include <ql/pricingengine.hpp>
+#include <ql/shared_ptr.hpp>
+#include <ql/timegrid.hpp>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "constantblackscholesprocess.hpp"
+#include "lognormalpathgenerator.hpp"
+#include "mcprofiler.hpp"
+#include "streamingstatistics.hpp"
+
+namespace QuantLib {
+
+    //------------------------------------------------------------------------
+    // Bump-and-revalue with common random numbers:
+    //   - each scenario bumps the constant process (spot, volatility,
+    //     risk-free rate) and is priced on paths driven by the same
+    //     normals as the base scenario
+    //   - the normals of a sample are drawn once and replayed for every
+    //     scenario, so a bump costs path construction and pricing only,
+    //     and finite differences between scenarios are free of sampling
+    //     noise from independent draws
+    //------------------------------------------------------------------------
+
+    //! Market bump applied to a constant Black-Scholes process
+    struct MarketScenario {
+        //! relative shift of the spot: x0 (1 + spotShift)
+        Real spotShift = 0.0;
+        //! absolute shift of the volatility
+        Volatility volatilityShift = 0.0;
+        //! absolute shift of the (continuous) risk-free rate
+        Rate rateShift = 0.0;
+    };
+
+    //! the process of a scenario
+    inline ext::shared_ptr<ConstantBlackScholesProcess>
+    bumpedProcess(const ConstantBlackScholesProcess& process,
+                  const MarketScenario& scenario) {
+        return ext::make_shared<ConstantBlackScholesProcess>(
+            process.x0() * (1.0 + scenario.spotShift),
+            process.dividendYield(),
+            process.riskFreeRate() + scenario.rateShift,
+            process.volatility() + scenario.volatilityShift);
+    }
+
+    //! Values of a set of scenarios on common random numbers
+    /*! The first process and pricer are those of the base scenario,
+        whose values go to the S accumulator (which drives the tolerance);
+        the others are accumulated in scenarios(), in the same order.
+        Each pricer must consume its own random numbers in step with the
+        others (e.g., barrier pricers built with the same uniform seed).
+    */
+    template <class RNG, class S>
+    class ScenarioMonteCarloModel {
+      public:
+        typedef typename RNG::rsg_type generator_type;
+        typedef PathPricer<Path> path_pricer_type;
+        typedef S stats_type;
+
+        ScenarioMonteCarloModel(
+            generator_type generator,
+            const TimeGrid& timeGrid,
+            bool brownianBridge,
+            bool antitheticVariate,
+            const std::vector<ext::shared_ptr<ConstantBlackScholesProcess> >& processes,
+            std::vector<ext::shared_ptr<path_pricer_type> > pathPricers);
+        void addSamples(Size samples);
+        const S& sampleAccumulator() const { return sampleAccumulator_; }
+        //! accumulators of the bumped scenarios
+        const std::vector<StreamingStatistics>& scenarios() const {
+            return scenarios_;
+        }
+        const McProfile& profile() const { return profile_; }
+      private:
+        // values of every scenario on the paths driven by sign*w_
+        void price(Real sign, std::vector<Real>& values);
+        generator_type generator_;
+        bool brownianBridge_;
+        BrownianBridge bb_;
+        bool antitheticVariate_;
+        std::vector<Real> x0_;
+        std::vector<std::vector<Real> > drift_, stdDev_;
+        std::vector<ext::shared_ptr<path_pricer_type> > pathPricers_;
+        std::vector<Real> w_, values_, antitheticValues_;
+        Path path_;
+        S sampleAccumulator_;
+        std::vector<StreamingStatistics> scenarios_;
+        McProfile profile_;
+    };
+
+
+    // template definitions
+
+    template <class RNG, class S>
+    inline ScenarioMonteCarloModel<RNG,S>::ScenarioMonteCarloModel(
+        generator_type generator,
+        const TimeGrid& timeGrid,
+        bool brownianBridge,
+        bool antitheticVariate,
+        const std::vector<ext::shared_ptr<ConstantBlackScholesProcess> >& processes,
+        std::vector<ext::shared_ptr<path_pricer_type> > pathPricers)
+    : generator_(std::move(generator)), brownianBridge_(brownianBridge),
+      bb_(timeGrid), antitheticVariate_(antitheticVariate),
+      pathPricers_(std::move(pathPricers)),
+      w_(timeGrid.size() - 1), values_(processes.size()),
+      antitheticValues_(processes.size()), path_(timeGrid),
+      scenarios_(processes.empty() ? 0 : processes.size() - 1) {
+        QL_REQUIRE(!processes.empty(), "no base scenario given");
+        QL_REQUIRE(pathPricers_.size() == processes.size(),
+                   "one pricer per scenario required");
+        QL_REQUIRE(generator_.dimension() == timeGrid.size() - 1,
+                   "sequence generator dimensionality ("
+                   << generator_.dimension() << ") != timeSteps ("
+                   << timeGrid.size() - 1 << ")");
+        typedef LogNormalStepTraits<ConstantBlackScholesProcess> traits;
+        Size steps = timeGrid.size() - 1;
+        for (const auto& process : processes) {
+            x0_.push_back(process->x0());
+            drift_.emplace_back(steps);
+            stdDev_.emplace_back(steps);
+            for (Size i = 0; i < steps; ++i) {
+                drift_.back()[i] = traits::drift(*process, timeGrid, i);
+                stdDev_.back()[i] = traits::stdDev(*process, timeGrid, i);
+            }
+        }
+    }
+
+    template <class RNG, class S>
+    inline void ScenarioMonteCarloModel<RNG,S>::price(Real sign,
+                                                      std::vector<Real>& values) {
+        for (Size k = 0; k < values.size(); ++k) {
+            {
+                QL_MC_PROFILE_PHASE(profile_, PathConstruction);
+                buildLogNormalPath(x0_[k], drift_[k], stdDev_[k], w_, sign, path_);
+            }
+            QL_MC_PROFILE_ONLY(++profile_.paths);
+            QL_MC_PROFILE_PHASE(profile_, Pricing);
+            values[k] = (*pathPricers_[k])(path_);
+        }
+    }
+
+    template <class RNG, class S>
+    inline void ScenarioMonteCarloModel<RNG,S>::addSamples(Size samples) {
+        for (Size j = 0; j < samples; ++j) {
+            Real weight;
+            {
+                // drawn once, replayed for every scenario
+                QL_MC_PROFILE_PHASE(profile_, RandomNumbers);
+                const typename generator_type::sample_type& sequence =
+                    generator_.nextSequence();
+                if (brownianBridge_)
+                    bb_.transform(sequence.value.begin(), sequence.value.end(),
+                                  w_.begin());
+                else
+                    std::copy(sequence.value.begin(), sequence.value.end(),
+                              w_.begin());
+                weight = sequence.weight;
+            }
+            QL_MC_PROFILE_ONLY(profile_.randomDraws += w_.size());
+
+            price(1.0, values_);
+            if (antitheticVariate_) {
+                price(-1.0, antitheticValues_);
+                for (Size k = 0; k < values_.size(); ++k)
+                    values_[k] = (values_[k] + antitheticValues_[k]) / 2.0;
+            }
+
+            QL_MC_PROFILE_PHASE(profile_, Accumulation);
+            sampleAccumulator_.add(values_[0], weight);
+            for (Size k = 1; k < values_.size(); ++k)
+                scenarios_[k - 1].add(values_[k], weight);
+        }
+    }
+
+    namespace detail {
+
+        template <class M, class = void>
+        struct has_scenarios : std::false_type {};
+
+        template <class M>
+        struct has_scenarios<M, decltype(void(std::declval<const M&>().scenarios()))>
+        : std::true_type {};
+
+    }
+
+    //! scenario accumulators of a model, or none
+    template <class Model>
+    inline std::vector<StreamingStatistics> scenariosOf(const Model& model) {
+        if constexpr (detail::has_scenarios<Model>::value)
+            return model.scenarios();
+        else
+            return std::vector<StreamingStatistics>();
+    }
+
+    //! adds the scenario accumulators of \c from to those of \c into
+    inline void mergeScenarios(std::vector<StreamingStatistics>& into,
+                               const std::vector<StreamingStatistics>& from) {
+        if (into.empty()) {
+            into = from;
+            return;
+        }
+        QL_REQUIRE(into.size() == from.size(), "different scenario sets");
+        for (Size k = 0; k < into.size(); ++k)
+            into[k].merge(from[k]);
+    }
+
+    //! writes the scenario values (and errors, if any) to an engine's results
+    /*! The errors are given by the caller, since they depend on how the
+        samples were drawn (see SamplingReport::scenarioErrorEstimates).
+    */
+    inline void addScenarioResults(const std::vector<StreamingStatistics>& scenarios,
+                                   const std::vector<Real>& errors,
+                                   std::map<std::string, ext::any>& results) {
+        std::vector<Real> values(scenarios.size());
+        for (Size k = 0; k < scenarios.size(); ++k)
+            values[k] = scenarios[k].mean();
+        results["scenarioValues"] = values;
+        if (!errors.empty()) {
+            QL_REQUIRE(errors.size() == scenarios.size(),
+                       "one error per scenario required");
+            results["scenarioErrorEstimates"] = errors;
+        }
+    }
+
+} // namespace QuantLib
+
+#endif
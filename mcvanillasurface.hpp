@@ -0,0 +1,340 @@
+#ifndef QL_MCVANILLASURFACE_HPP
+#define QL_MCVANILLASURFACE_HPP
+
+#include <ql/math/matrix.hpp>
+#include <ql/methods/montecarlo/mctraits.hpp>
+#include <ql/processes/blackscholesprocess.hpp>
+#include <ql/instruments/payoffs.hpp>
+#include <ql/timegrid.hpp>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "myconstutil.hpp"
+#include "lognormalpathgenerator.hpp"
+#include "mcparallel.hpp"
+#include "mcportfoliopricer.hpp"
+#include "mcprofiler.hpp"
+#include "mcrandomizedqmc.hpp"
+#include "streamingstatistics.hpp"
+
+namespace QuantLib {
+
+    //------------------------------------------------------------------------
+    // Strike/maturity surface of European options from one path set:
+    //   - the paths are simulated once, on a grid whose nodes are the
+    //     maturities, with the process constant on each interval
+    //     (variance and discount factors exact at the maturities)
+    //   - each path is evaluated by every payoff at every maturity, so
+    //     path generation is shared by the whole surface instead of being
+    //     repeated by one MCEuropeanEngine_2 run per option
+    //   - the smile is read at a single reference strike (at the money by
+    //     default): one path set has one volatility per interval
+    //------------------------------------------------------------------------
+
+    //! Values and errors of a surface, one row per maturity and one column
+    //! per payoff, in the order they were given
+    struct VanillaSurfaceResults {
+        Matrix value;
+        Matrix errorEstimate;
+        Size samples;
+    };
+
+    //! Monte Carlo model pricing all the payoffs at all the maturity nodes
+    /*! The accumulator of payoff k at maturity m is at m*payoffs+k of the
+        PortfolioStatistics; its errorEstimate() is the largest of the
+        surface, so that a tolerance applies to every option.
+    */
+    template <class RNG, class S>
+    class VanillaSurfaceMonteCarloModel {
+      public:
+        typedef LogNormalPathGenerator<typename RNG::rsg_type,
+                                       PiecewiseConstantBlackScholesProcess>
+            path_generator_type;
+        typedef PortfolioStatistics<S> stats_type;
+
+        VanillaSurfaceMonteCarloModel(
+                     ext::shared_ptr<path_generator_type> pathGenerator,
+                     std::vector<Size> maturityNodes,
+                     std::vector<DiscountFactor> discounts,
+                     const std::vector<ext::shared_ptr<PlainVanillaPayoff> >& payoffs,
+                     bool antitheticVariate);
+        void addSamples(Size samples);
+        const stats_type& sampleAccumulator() const {
+            return sampleAccumulator_;
+        }
+        const McProfile& profile() const { return profile_; }
+      private:
+        // payoffs of the path at every maturity, discounted, into values
+        void price(const Path& path, std::vector<Real>& values) const;
+        ext::shared_ptr<path_generator_type> pathGenerator_;
+        std::vector<Size> maturityNodes_;
+        std::vector<DiscountFactor> discounts_;
+        // max(phi (S - K), 0) sans appel virtuel au payoff
+        std::vector<Real> phi_, strikes_;
+        bool antitheticVariate_;
+        std::vector<Real> values_, antitheticValues_;
+        stats_type sampleAccumulator_;
+        McProfile profile_;
+    };
+
+
+    //! Prices a strip of European options with a single simulation
+    /*! Every payoff is priced at every maturity.  The paths are those of
+        the piecewise-constant process extracted on the maturities at the
+        reference strike, which is exact in log-normal terms at the nodes:
+        no intermediate step is needed.
+
+        Randomized QMC (ScrambledSobol) is refused, as by MCPortfolioPricer:
+        its error would need independent replicates of the whole surface.
+
+        The default accumulator keeps one mean and variance per option,
+        whatever the number of samples.
+    */
+    template <class RNG = PseudoRandom, class S = StreamingStatistics>
+    class MCVanillaSurfacePricer {
+      public:
+        MCVanillaSurfacePricer(
+                    ext::shared_ptr<GeneralizedBlackScholesProcess> process,
+                    std::vector<Date> maturities,
+                    std::vector<ext::shared_ptr<PlainVanillaPayoff> > payoffs);
+        // named parameters
+        MCVanillaSurfacePricer& withReferenceStrike(Real strike);
+        MCVanillaSurfacePricer& withBrownianBridge(bool b = true);
+        MCVanillaSurfacePricer& withAntitheticVariate(bool b = true);
+        MCVanillaSurfacePricer& withSamples(Size samples);
+        MCVanillaSurfacePricer& withAbsoluteTolerance(Real tolerance);
+        MCVanillaSurfacePricer& withMaxSamples(Size samples);
+        MCVanillaSurfacePricer& withSeed(BigNatural seed);
+        MCVanillaSurfacePricer& withThreads(Size n);
+        //! simulates the paths and prices the whole surface
+        VanillaSurfaceResults calculate() const;
+      private:
+        ext::shared_ptr<GeneralizedBlackScholesProcess> process_;
+        std::vector<Date> maturities_;
+        std::vector<ext::shared_ptr<PlainVanillaPayoff> > payoffs_;
+        Real referenceStrike_;
+        bool brownianBridge_ = is_low_discrepancy<RNG>::value;
+        bool antithetic_ = false;
+        Size samples_, maxSamples_;
+        Real tolerance_;
+        BigNatural seed_ = 0;
+        Size threads_ = 1;
+        mutable ConstantProcessCache constantProcessCache_;
+    };
+
+
+    // template definitions
+
+    template <class RNG, class S>
+    inline VanillaSurfaceMonteCarloModel<RNG,S>::VanillaSurfaceMonteCarloModel(
+                     ext::shared_ptr<path_generator_type> pathGenerator,
+                     std::vector<Size> maturityNodes,
+                     std::vector<DiscountFactor> discounts,
+                     const std::vector<ext::shared_ptr<PlainVanillaPayoff> >& payoffs,
+                     bool antitheticVariate)
+    : pathGenerator_(std::move(pathGenerator)),
+      maturityNodes_(std::move(maturityNodes)),
+      discounts_(std::move(discounts)),
+      antitheticVariate_(antitheticVariate),
+      values_(maturityNodes_.size() * payoffs.size()),
+      antitheticValues_(maturityNodes_.size() * payoffs.size()),
+      sampleAccumulator_(maturityNodes_.size() * payoffs.size()) {
+        QL_REQUIRE(!maturityNodes_.empty(), "no maturities given");
+        QL_REQUIRE(!payoffs.empty(), "no payoffs given");
+        QL_REQUIRE(discounts_.size() == maturityNodes_.size(),
+                   "one discount factor per maturity required");
+        for (const auto& payoff : payoffs) {
+            phi_.push_back(payoff->optionType() == Option::Call ? 1.0 : -1.0);
+            strikes_.push_back(payoff->strike());
+        }
+    }
+
+    template <class RNG, class S>
+    inline void VanillaSurfaceMonteCarloModel<RNG,S>::price(
+                                             const Path& path,
+                                             std::vector<Real>& values) const {
+        Size n = strikes_.size();
+        for (Size m = 0; m < maturityNodes_.size(); ++m) {
+            Real spot = path[maturityNodes_[m]];
+            DiscountFactor discount = discounts_[m];
+            Real* v = &values[m * n];
+            for (Size k = 0; k < n; ++k)
+                v[k] = discount * std::max<Real>(phi_[k] * (spot - strikes_[k]), 0.0);
+        }
+    }
+
+    template <class RNG, class S>
+    inline void VanillaSurfaceMonteCarloModel<RNG,S>::addSamples(Size samples) {
+        for (Size j = 0; j < samples; ++j) {
+            const typename path_generator_type::sample_type* path;
+            {
+                QL_MC_PROFILE_PHASE(profile_, PathConstruction);
+                path = &pathGenerator_->next();
+            }
+            QL_MC_PROFILE_ONLY(++profile_.paths);
+            QL_MC_PROFILE_ONLY(profile_.randomDraws += path->value.length() - 1);
+            Real weight = path->weight;
+            {
+                QL_MC_PROFILE_PHASE(profile_, Pricing);
+                price(path->value, values_);
+            }
+
+            if (antitheticVariate_) {
+                {
+                    // next() et antithetic() partagent leur stockage
+                    QL_MC_PROFILE_PHASE(profile_, PathConstruction);
+                    path = &pathGenerator_->antithetic();
+                }
+                QL_MC_PROFILE_ONLY(++profile_.paths);
+                QL_MC_PROFILE_PHASE(profile_, Pricing);
+                price(path->value, antitheticValues_);
+                for (Size k = 0; k < values_.size(); ++k)
+                    values_[k] = (values_[k] + antitheticValues_[k]) / 2.0;
+            }
+
+            QL_MC_PROFILE_PHASE(profile_, Accumulation);
+            for (Size k = 0; k < values_.size(); ++k)
+                sampleAccumulator_[k].add(values_[k], weight);
+        }
+    }
+
+    template <class RNG, class S>
+    inline MCVanillaSurfacePricer<RNG,S>::MCVanillaSurfacePricer(
+                    ext::shared_ptr<GeneralizedBlackScholesProcess> process,
+                    std::vector<Date> maturities,
+                    std::vector<ext::shared_ptr<PlainVanillaPayoff> > payoffs)
+    : process_(std::move(process)), maturities_(std::move(maturities)),
+      payoffs_(std::move(payoffs)), referenceStrike_(Null<Real>()),
+      samples_(Null<Size>()), maxSamples_(Null<Size>()),
+      tolerance_(Null<Real>()) {
+        QL_REQUIRE(process_, "no process given");
+        QL_REQUIRE(!maturities_.empty(), "no maturities given");
+        QL_REQUIRE(!payoffs_.empty(), "no payoffs given");
+        for (const auto& payoff : payoffs_)
+            QL_REQUIRE(payoff, "null payoff given");
+        static_assert(!is_randomized_qmc<RNG>::value,
+                      "randomized QMC not supported by the surface pricer");
+    }
+
+    template <class RNG, class S>
+    inline VanillaSurfaceResults MCVanillaSurfacePricer<RNG,S>::calculate() const {
+        // les maturités, dans l'ordre donné, sont les noeuds de la grille
+        std::vector<Time> times(maturities_.size());
+        for (Size m = 0; m < maturities_.size(); ++m) {
+            times[m] = process_->time(maturities_[m]);
+            QL_REQUIRE(times[m] > 0.0,
+                       "expired maturity given (" << maturities_[m] << ")");
+        }
+        TimeGrid grid(times.begin(), times.end());
+
+        std::vector<Size> maturityNodes(times.size());
+        std::vector<DiscountFactor> discounts(times.size());
+        for (Size m = 0; m < times.size(); ++m) {
+            maturityNodes[m] = grid.index(times[m]);
+            discounts[m] = process_->riskFreeRate()->discount(times[m]);
+        }
+
+        Real strike = referenceStrike_ != Null<Real>() ? referenceStrike_
+                                                       : process_->x0();
+        ext::shared_ptr<PiecewiseConstantBlackScholesProcess> process =
+            constantProcessCache_.getPiecewise(process_, grid, strike);
+
+        auto makeModel = [&](Size i) {
+            typedef typename VanillaSurfaceMonteCarloModel<RNG,S>::path_generator_type
+                path_generator_type;
+            return ext::make_shared<VanillaSurfaceMonteCarloModel<RNG,S> >(
+                ext::make_shared<path_generator_type>(
+                    *process, grid,
+                    RNG::make_sequence_generator(grid.size() - 1,
+                                                 deriveSeed(seed_, i)),
+                    brownianBridge_),
+                maturityNodes, discounts, payoffs_, antithetic_);
+        };
+        PortfolioStatistics<S> stats =
+            simulateInParallel(threads_, makeModel,
+                               tolerance_, samples_, maxSamples_);
+
+        Size n = payoffs_.size();
+        VanillaSurfaceResults results;
+        results.value = Matrix(times.size(), n);
+        results.errorEstimate = Matrix(times.size(), n, Null<Real>());
+        results.samples = stats.samples();
+        for (Size m = 0; m < times.size(); ++m) {
+            for (Size k = 0; k < n; ++k) {
+                results.value[m][k] = stats[m * n + k].mean();
+                if (RNG::allowsErrorEstimate)
+                    results.errorEstimate[m][k] = stats[m * n + k].errorEstimate();
+            }
+        }
+        return results;
+    }
+
+    template <class RNG, class S>
+    inline MCVanillaSurfacePricer<RNG,S>&
+    MCVanillaSurfacePricer<RNG,S>::withReferenceStrike(Real strike) {
+        QL_REQUIRE(strike > 0.0, "positive reference strike required");
+        referenceStrike_ = strike;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MCVanillaSurfacePricer<RNG,S>&
+    MCVanillaSurfacePricer<RNG,S>::withBrownianBridge(bool b) {
+        brownianBridge_ = b;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MCVanillaSurfacePricer<RNG,S>&
+    MCVanillaSurfacePricer<RNG,S>::withAntitheticVariate(bool b) {
+        antithetic_ = b;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MCVanillaSurfacePricer<RNG,S>&
+    MCVanillaSurfacePricer<RNG,S>::withSamples(Size samples) {
+        QL_REQUIRE(tolerance_ == Null<Real>(), "tolerance already set");
+        samples_ = samples;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MCVanillaSurfacePricer<RNG,S>&
+    MCVanillaSurfacePricer<RNG,S>::withAbsoluteTolerance(Real tolerance) {
+        QL_REQUIRE(samples_ == Null<Size>(),
+                   "number of samples already set");
+        QL_REQUIRE(RNG::allowsErrorEstimate,
+                   "chosen random generator policy "
+                   "does not allow an error estimate");
+        tolerance_ = tolerance;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MCVanillaSurfacePricer<RNG,S>&
+    MCVanillaSurfacePricer<RNG,S>::withMaxSamples(Size samples) {
+        maxSamples_ = samples;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MCVanillaSurfacePricer<RNG,S>&
+    MCVanillaSurfacePricer<RNG,S>::withSeed(BigNatural seed) {
+        seed_ = seed;
+        return *this;
+    }
+
+    template <class RNG, class S>
+    inline MCVanillaSurfacePricer<RNG,S>&
+    MCVanillaSurfacePricer<RNG,S>::withThreads(Size n) {
+        QL_REQUIRE(n > 0, "at least one thread required");
+        checkThreadsForGenerator<RNG>(n);
+        threads_ = n;
+        return *this;
+    }
+
+}
+
+#endif
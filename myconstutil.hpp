@@ -3,8 +3,19 @@
 
 #include <ql/processes/blackscholesprocess.hpp>
 #include "constantblackscholesprocess.hpp"
+#include "piecewiseconstantblackscholesprocess.hpp"
+#include "mcprofiler.hpp"
+#include <ql/patterns/observable.hpp>
 #include <ql/payoff.hpp>
 #include <ql/types.hpp>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <tuple>
+#include <vector>
 
 namespace QuantLib {
 
@@ -33,6 +44,163 @@ namespace QuantLib {
         );
     }
 
+    /*!
+      \brief Construit un PiecewiseConstantBlackScholesProcess sur la grille.
+
+      Taux sans risque, dividende et variance forward de chaque intervalle
+      [t_i, t_{i+1}] sont déduits des courbes (facteurs d'actualisation et
+      variance noire au strike), de sorte que les facteurs d'actualisation
+      et la variance aux noeuds de la grille sont exacts.
+
+      \param BS_process  Un GeneralizedBlackScholesProcess
+      \param grid        La grille de simulation
+      \param strike      Le strike (extrait du payoff)
+    */
+    inline ext::shared_ptr<PiecewiseConstantBlackScholesProcess>
+    makePiecewiseConstantProcess(
+        const ext::shared_ptr<GeneralizedBlackScholesProcess>& BS_process,
+        const TimeGrid& grid,
+        Real strike
+    ) {
+        Size n = grid.size() - 1;
+        std::vector<Rate> riskFreeRates(n), dividendYields(n);
+        std::vector<Volatility> volatilities(n);
+
+        const auto& riskFree = BS_process->riskFreeRate();
+        const auto& dividend = BS_process->dividendYield();
+        const auto& vol      = BS_process->blackVolatility();
+        DiscountFactor riskFreeDiscount = riskFree->discount(grid[0]);
+        DiscountFactor dividendDiscount = dividend->discount(grid[0]);
+        Real variance = grid[0] > 0.0 ? vol->blackVariance(grid[0], strike) : 0.0;
+        for (Size i = 0; i < n; ++i) {
+            Time t = grid[i + 1], dt = grid.dt(i);
+            DiscountFactor nextRiskFree = riskFree->discount(t);
+            DiscountFactor nextDividend = dividend->discount(t);
+            Real nextVariance = vol->blackVariance(t, strike);
+
+            riskFreeRates[i]  = std::log(riskFreeDiscount / nextRiskFree) / dt;
+            dividendYields[i] = std::log(dividendDiscount / nextDividend) / dt;
+            // une variance décroissante (arbitrage calendaire) est tronquée
+            volatilities[i]   = std::sqrt(std::max<Real>(nextVariance - variance, 0.0) / dt);
+
+            riskFreeDiscount = nextRiskFree;
+            dividendDiscount = nextDividend;
+            variance = std::max(variance, nextVariance);
+        }
+
+        return ext::make_shared<PiecewiseConstantBlackScholesProcess>(
+            BS_process->x0(), grid, riskFreeRates, dividendYields, volatilities
+        );
+    }
+
+    /*!
+      \brief Cache des ConstantBlackScholesProcess extraits par makeConstantProcess.
+
+      Clé : (identité du process, temps d'extraction, strike). Le cache
+      s'enregistre auprès de chaque process rencontré et se vide à la
+      première notification (quote, courbe de taux ou de vol modifiée) :
+      l'extraction n'est donc refaite qu'une fois par mise à jour du marché.
+
+      Les process renvoyés sont partagés entre les appels. Le process
+      constant n'a pas d'état mutable et peut être évolué depuis plusieurs
+      threads ; le process par intervalle garde l'intervalle courant et doit
+      être copié par thread.
+    */
+    class ConstantProcessCache : public Observer {
+      public:
+        ext::shared_ptr<ConstantBlackScholesProcess>
+        get(const ext::shared_ptr<GeneralizedBlackScholesProcess>& BS_process,
+            Time time_of_extraction,
+            Real strike) {
+            key_type key(BS_process.get(), time_of_extraction, strike);
+            auto i = processes_.find(key);
+            if (i != processes_.end())
+                return i->second;
+
+            // l'enregistrement garde le process en vie : son adresse
+            // reste une clé valide tant que l'entrée existe
+            registerWith(BS_process);
+            QL_MC_PROFILE_PHASE(profile_, Extraction);
+            QL_MC_PROFILE_ONLY(++profile_.extractions);
+            auto cst_BS_process =
+                makeConstantProcess(BS_process, time_of_extraction, strike);
+            processes_[key] = cst_BS_process;
+            return cst_BS_process;
+        }
+        //! même principe pour makePiecewiseConstantProcess
+        /*! Clé : (process, taille, premier et dernier noeud, empreinte de
+            la grille, strike), sans copie de la grille ; la grille du
+            process trouvé est comparée à celle demandée, une collision
+            d'empreintes donnant une nouvelle extraction.  Au plus
+            maxPiecewiseProcesses grilles sont gardées, la plus ancienne
+            étant retirée la première.
+        */
+        ext::shared_ptr<PiecewiseConstantBlackScholesProcess>
+        getPiecewise(const ext::shared_ptr<GeneralizedBlackScholesProcess>& BS_process,
+                     const TimeGrid& grid,
+                     Real strike) {
+            piecewise_key_type key(BS_process.get(), grid.size(),
+                                   grid.front(), grid.back(),
+                                   gridHash(grid), strike);
+            auto i = piecewiseProcesses_.find(key);
+            if (i != piecewiseProcesses_.end() &&
+                std::equal(grid.begin(), grid.end(),
+                           i->second->timeGrid().begin()))
+                return i->second;
+
+            registerWith(BS_process);
+            QL_MC_PROFILE_PHASE(profile_, Extraction);
+            QL_MC_PROFILE_ONLY(++profile_.extractions);
+            auto pw_BS_process =
+                makePiecewiseConstantProcess(BS_process, grid, strike);
+            if (i != piecewiseProcesses_.end()) {
+                i->second = pw_BS_process;
+            } else {
+                if (piecewiseProcesses_.size() == maxPiecewiseProcesses) {
+                    piecewiseProcesses_.erase(piecewiseOrder_.front());
+                    piecewiseOrder_.pop_front();
+                }
+                piecewiseProcesses_[key] = pw_BS_process;
+                piecewiseOrder_.push_back(key);
+            }
+            return pw_BS_process;
+        }
+        void update() override {
+            processes_.clear();
+            piecewiseProcesses_.clear();
+            piecewiseOrder_.clear();
+        }
+        Size size() const {
+            return processes_.size() + piecewiseProcesses_.size();
+        }
+        //! extractions faites depuis le dernier resetProfile() (QL_MC_PROFILE)
+        const McProfile& profile() const { return profile_; }
+        void resetProfile() { profile_ = McProfile(); }
+
+      private:
+        typedef std::tuple<const GeneralizedBlackScholesProcess*, Time, Real>
+            key_type;
+        typedef std::tuple<const GeneralizedBlackScholesProcess*,
+                           Size, Time, Time, std::size_t, Real>
+            piecewise_key_type;
+        static constexpr Size maxPiecewiseProcesses = 64;
+        // empreinte des noeuds de la grille (combinaison à la boost)
+        static std::size_t gridHash(const TimeGrid& grid) {
+            std::size_t seed = 0;
+            for (Time t : grid)
+                seed ^= std::hash<Time>()(t) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            return seed;
+        }
+        std::map<key_type, ext::shared_ptr<ConstantBlackScholesProcess> >
+            processes_;
+        std::map<piecewise_key_type,
+                 ext::shared_ptr<PiecewiseConstantBlackScholesProcess> >
+            piecewiseProcesses_;
+        // clés des grilles dans l'ordre d'insertion, pour l'éviction
+        std::deque<piecewise_key_type> piecewiseOrder_;
+        McProfile profile_;
+    };
+
 } // namespace QuantLib
 
 #endif
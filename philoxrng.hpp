@@ -0,0 +1,150 @@
+#ifndef QL_PHILOXRNG_HPP
+#define QL_PHILOXRNG_HPP
+
+#include <ql/math/randomnumbers/seedgenerator.hpp>
+#include <ql/methods/montecarlo/sample.hpp>
+#include <ql/errors.hpp>
+#include <ql/types.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "simdkernels.hpp"
+
+namespace QuantLib {
+
+    //! Philox4x32-10 counter-based generator (Salmon et al., 2011)
+    /*! A keyed bijection of a 128-bit counter: the n-th output of a
+        stream is computed from (key, n) alone, so that a stream can be
+        skipped ahead at no cost and consecutive counters are computed
+        independently of each other.
+    */
+    class Philox4x32 {
+      public:
+        typedef std::array<std::uint32_t, 4> counter_type;
+        typedef std::array<std::uint32_t, 2> key_type;
+
+        static counter_type apply(counter_type counter, key_type key) {
+            round(counter, key);
+            for (Size r = 1; r < 10; ++r) {
+                key[0] += W0;
+                key[1] += W1;
+                round(counter, key);
+            }
+            return counter;
+        }
+      private:
+        static constexpr std::uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+        static constexpr std::uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+        static void round(counter_type& c, const key_type& k) {
+            std::uint64_t p0 = std::uint64_t(M0) * c[0];
+            std::uint64_t p1 = std::uint64_t(M1) * c[2];
+            c = {{ std::uint32_t(p1 >> 32) ^ c[1] ^ k[0], std::uint32_t(p1),
+                   std::uint32_t(p0 >> 32) ^ c[3] ^ k[1], std::uint32_t(p0) }};
+        }
+    };
+
+    //! Gaussian sequence generator drawing its normals in blocks
+    /*! The normals of the d-dimensional sequences are read in order from
+        a single Philox stream keyed by the seed: the i-th sequence uses
+        the normals [i*d, (i+1)*d) of the stream, the n-th normal coming
+        from the (n/2)-th counter.  They are produced a block at a time:
+        53-bit uniforms from the counters, then vectorInverseNormal() over
+        the whole block.  The stream does not depend on the block size,
+        and skipTo(i) moves to the i-th sequence in constant time.
+
+        Same interface as the Gaussian sequence generators of QuantLib
+        (e.g., for PathGenerator); not thread-safe.
+    */
+    class PhiloxNormalRsg {
+      public:
+        typedef Sample<std::vector<Real> > sample_type;
+
+        PhiloxNormalRsg(Size dimensionality,
+                        BigNatural seed = 0,
+                        Size blockSize = 1024);
+        const sample_type& nextSequence() const;
+        const sample_type& lastSequence() const { return sequence_; }
+        Size dimension() const { return sequence_.value.size(); }
+        //! the next call to nextSequence() returns the i-th sequence
+        void skipTo(BigNatural i) { next_ = std::uint64_t(i) * dimension(); }
+      private:
+        // normals [first, first + blockSize) of the stream, first even
+        void fill(std::uint64_t first) const;
+        Philox4x32::key_type key_;
+        mutable std::uint64_t next_, bufferStart_, bufferEnd_;
+        mutable std::vector<Real> uniforms_, normals_;
+        mutable sample_type sequence_;
+    };
+
+    //! Pseudo-random traits drawing normals in blocks from Philox
+    /*! Usable as the RNG parameter of the _2 engines in place of
+        PseudoRandom.  Each seed, and thus each worker seed given by
+        deriveSeed(), keys an independent stream; seed 0 takes one from
+        SeedGenerator.
+    */
+    struct PhiloxRandom {
+        typedef PhiloxNormalRsg rsg_type;
+        enum { allowsErrorEstimate = 1 };
+        static rsg_type make_sequence_generator(Size dimension,
+                                                BigNatural seed) {
+            return rsg_type(dimension, seed);
+        }
+    };
+
+
+    // inline definitions
+
+    inline PhiloxNormalRsg::PhiloxNormalRsg(Size dimensionality,
+                                            BigNatural seed,
+                                            Size blockSize)
+    : next_(0), bufferStart_(0), bufferEnd_(0),
+      uniforms_(std::max<Size>(2, blockSize + blockSize % 2)),
+      normals_(uniforms_.size()),
+      sequence_(std::vector<Real>(dimensionality), 1.0) {
+        QL_REQUIRE(dimensionality > 0, "dimensionality must be greater than 0");
+        if (seed == 0)
+            seed = SeedGenerator::instance().get();
+        std::uint64_t key = seed;
+        key_ = {{ std::uint32_t(key), std::uint32_t(key >> 32) }};
+    }
+
+    inline const PhiloxNormalRsg::sample_type&
+    PhiloxNormalRsg::nextSequence() const {
+        Size d = dimension();
+        for (Size k = 0; k < d;) {
+            if (next_ < bufferStart_ || next_ >= bufferEnd_)
+                fill(next_ - next_ % 2);
+            Size offset = Size(next_ - bufferStart_);
+            Size n = std::min<Size>(d - k, normals_.size() - offset);
+            std::copy(normals_.begin() + offset, normals_.begin() + offset + n,
+                      sequence_.value.begin() + k);
+            k += n;
+            next_ += n;
+        }
+        return sequence_;
+    }
+
+    inline void PhiloxNormalRsg::fill(std::uint64_t first) const {
+        // uniforms in (0,1) from the 53 upper bits of each 64-bit half
+        const Real scale = 1.0 / 9007199254740992.0;
+        std::uint64_t counter = first / 2;
+        Real* u = &uniforms_[0];
+        for (Size m = 0; m < uniforms_.size() / 2; ++m, ++counter) {
+            Philox4x32::counter_type c = Philox4x32::apply(
+                {{ std::uint32_t(counter), std::uint32_t(counter >> 32), 0, 0 }},
+                key_);
+            std::uint64_t lo = (std::uint64_t(c[1]) << 32) | c[0];
+            std::uint64_t hi = (std::uint64_t(c[3]) << 32) | c[2];
+            u[2 * m] = (Real(lo >> 11) + 0.5) * scale;
+            u[2 * m + 1] = (Real(hi >> 11) + 0.5) * scale;
+        }
+        vectorInverseNormal(u, &normals_[0], normals_.size());
+        bufferStart_ = first;
+        bufferEnd_ = first + normals_.size();
+    }
+
+} // namespace QuantLib
+
+#endif
@@ -0,0 +1,109 @@
+#include <ql/qldefines.hpp>
+#ifdef BOOST_MSVC
+#  include <ql/auto_link.hpp>
+#endif
+#include <ql/errors.hpp>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include "piecewiseconstantblackscholesprocess.hpp"
+namespace QuantLib {
+
+    // The drift and the standard deviation over each interval of the
+    // grid are computed once; evolve() only looks them up.
+    PiecewiseConstantBlackScholesProcess::PiecewiseConstantBlackScholesProcess(
+                                        Real x0,
+                                        TimeGrid timeGrid,
+                                        std::vector<Rate> riskFreeRates,
+                                        std::vector<Rate> dividendYields,
+                                        std::vector<Volatility> volatilities)
+        : x0_(x0), timeGrid_(std::move(timeGrid)),
+          riskFreeRates_(std::move(riskFreeRates)),
+          dividendYields_(std::move(dividendYields)),
+          volatilities_(std::move(volatilities)),
+          lastInterval_(0) {
+        Size n = timeGrid_.size() - 1;
+        QL_REQUIRE(n > 0, "at least one interval required");
+        QL_REQUIRE(riskFreeRates_.size() == n &&
+                   dividendYields_.size() == n &&
+                   volatilities_.size() == n,
+                   "one rate, yield and volatility per interval required");
+        logDrifts_.resize(n);
+        stdDevs_.resize(n);
+        discounts_.resize(n + 1);
+        Real logDiscount = 0.0;
+        discounts_[0] = 1.0;
+        for (Size i = 0; i < n; ++i) {
+            Time dt = timeGrid_.dt(i);
+            logDrifts_[i] = riskFreeRates_[i] - dividendYields_[i]
+                          - 0.5 * volatilities_[i] * volatilities_[i];
+            stdDevs_[i] = volatilities_[i] * std::sqrt(dt);
+            logDiscount -= riskFreeRates_[i] * dt;
+            discounts_[i + 1] = std::exp(logDiscount);
+        }
+    }
+
+    Real PiecewiseConstantBlackScholesProcess::x0() const {
+        return x0_;
+    }
+
+    Real PiecewiseConstantBlackScholesProcess::drift(Time t, Real) const {
+        return logDrifts_[interval(t)];
+    }
+
+    Real PiecewiseConstantBlackScholesProcess::diffusion(Time t, Real) const {
+        return volatilities_[interval(t)];
+    }
+
+    Real PiecewiseConstantBlackScholesProcess::apply(Real x0, Real dx) const {
+        return x0 * std::exp(dx);
+    }
+
+    Real PiecewiseConstantBlackScholesProcess::expectation(Time t0, Real x0,
+                                                           Time dt) const {
+        Size i = interval(t0);
+        return x0 * std::exp((riskFreeRates_[i] - dividendYields_[i]) * dt);
+    }
+
+    Real PiecewiseConstantBlackScholesProcess::stdDeviation(Time t0, Real,
+                                                            Time dt) const {
+        Size i = interval(t0);
+        if (dt == timeGrid_.dt(i))
+            return stdDevs_[i];
+        return volatilities_[i] * std::sqrt(dt);
+    }
+
+    Real PiecewiseConstantBlackScholesProcess::variance(Time t0, Real x0,
+                                                        Time dt) const {
+        Real s = stdDeviation(t0, x0, dt);
+        return s * s;
+    }
+
+    Real PiecewiseConstantBlackScholesProcess::evolve(Time t0, Real x0,
+                                                      Time dt, Real dw) const {
+        Size i = interval(t0);
+        Real stdDev = (dt == timeGrid_.dt(i)) ? stdDevs_[i]
+                                              : volatilities_[i] * std::sqrt(dt);
+        return x0 * std::exp(logDrifts_[i] * dt + stdDev * dw);
+    }
+
+    // index i of the interval [t_i, t_{i+1}) containing t; times before
+    // the grid map to the first interval and times after it to the last
+    Size PiecewiseConstantBlackScholesProcess::interval(Time t) const {
+        Size n = logDrifts_.size();
+        // PathGenerator asks for the same interval or the next one
+        for (Size i = lastInterval_; i < std::min(lastInterval_ + 2, n); ++i) {
+            if (timeGrid_[i] <= t && (t < timeGrid_[i + 1] || i == n - 1)) {
+                lastInterval_ = i;
+                return i;
+            }
+        }
+        auto upper = std::upper_bound(timeGrid_.begin(), timeGrid_.end(), t);
+        Size i = upper == timeGrid_.begin()
+                     ? 0
+                     : std::min<Size>(upper - timeGrid_.begin() - 1, n - 1);
+        lastInterval_ = i;
+        return i;
+    }
+
+}
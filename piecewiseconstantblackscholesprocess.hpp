@@ -0,0 +1,61 @@
+#ifndef PIECEWISE_CONSTANT_BLACK_SCHOLES_PROCESS_HPP
+#define PIECEWISE_CONSTANT_BLACK_SCHOLES_PROCESS_HPP
+
+#include <ql/stochasticprocess.hpp>
+#include <ql/timegrid.hpp>
+#include <vector>
+
+namespace QuantLib {
+
+    /*! Black-Scholes process whose rates and volatility are constant on
+        each interval of a time grid.
+
+        The forward risk-free rate, dividend yield and variance of each
+        interval are read once from the term structures, so that the
+        discount factors and the variance at the grid nodes are those of
+        the curves.  On each interval the log-spot increment is exactly
+        Gaussian and evolve() steps in closed form, as
+        ConstantBlackScholesProcess does.
+
+        evolve() remembers the last interval used, since PathGenerator
+        walks the grid in order; like ConstantBlackScholesProcess, an
+        instance must not be evolved from several threads at once.
+    */
+    class PiecewiseConstantBlackScholesProcess : public StochasticProcess1D {
+        public:
+            //! rates and volatilities given for each interval of the grid
+            PiecewiseConstantBlackScholesProcess(Real x0,
+                                                 TimeGrid timeGrid,
+                                                 std::vector<Rate> riskFreeRates,
+                                                 std::vector<Rate> dividendYields,
+                                                 std::vector<Volatility> volatilities);
+            Real x0() const override;
+            //! log-space drift r-q-sigma^2/2 of the interval containing t
+            Real drift(Time t, Real x) const override;
+            Real diffusion(Time t, Real x) const override;
+            Real apply(Real x0, Real dx) const override;
+            Real expectation(Time t0, Real x0, Time dt) const override;
+            Real stdDeviation(Time t0, Real x0, Time dt) const override;
+            Real variance(Time t0, Real x0, Time dt) const override;
+            //! exact log-normal step, with the parameters of the interval containing t0
+            Real evolve(Time t0, Real x0, Time dt, Real dw) const override;
+
+            const TimeGrid& timeGrid() const { return timeGrid_; }
+            //! log-space drift r-q-sigma^2/2 on the i-th interval
+            Real logDrift(Size i) const { return logDrifts_[i]; }
+            Volatility volatility(Size i) const { return volatilities_[i]; }
+            //! risk-free discount factor at the i-th grid node
+            DiscountFactor discount(Size i) const { return discounts_[i]; }
+        private:
+            Size interval(Time t) const;
+
+            Real x0_;
+            TimeGrid timeGrid_;
+            std::vector<Rate> riskFreeRates_, dividendYields_;
+            std::vector<Volatility> volatilities_;
+            std::vector<Real> logDrifts_, stdDevs_;
+            std::vector<DiscountFactor> discounts_;
+            mutable Size lastInterval_;
+    };
+};
+#endif // PIECEWISE_CONSTANT_BLACK_SCHOLES_PROCESS_HPP
@@ -0,0 +1,159 @@
+#ifndef QL_STREAMINGSTATISTICS_HPP
+#define QL_STREAMINGSTATISTICS_HPP
+
+#include <ql/errors.hpp>
+#include <ql/types.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace QuantLib {
+
+    //! Statistics kept in constant memory, whatever the number of samples
+    /*! Can be used as the S parameter of the _2 engines instead of
+        Statistics, which stores every sample.  The weighted mean and
+        variance are updated in a single pass (West's weighted version of
+        Welford's algorithm), and two accumulators are merged exactly
+        (Chan et al.), so that the accumulators of several threads can be
+        pooled; mean(), variance() and errorEstimate() follow the
+        conventions of GeneralStatistics.
+
+        Percentiles are optional: given a range and a number of bins,
+        the weights are also accumulated in a fixed histogram and
+        percentile() interpolates within the bins; samples outside the
+        range fall in the first or last bin.  By default (as when an
+        engine builds the accumulator) there is a single bin and no
+        percentiles.
+
+        add() has no branch; weights must be positive.
+    */
+    class StreamingStatistics {
+      public:
+        StreamingStatistics() : StreamingStatistics(0.0, 1.0, 1) {}
+        //! histogram of \c bins bins over [lower, upper)
+        StreamingStatistics(Real lower, Real upper, Size bins)
+        : lower_(lower), upper_(upper),
+          scale_(bins > 1 ? bins / (upper - lower) : 0.0),
+          lastBin_(bins > 0 ? bins - 1.0 : 0.0),
+          histogram_(bins) {
+            QL_REQUIRE(bins > 0, "at least one bin required");
+            QL_REQUIRE(upper > lower, "empty histogram range");
+            reset();
+        }
+
+        //! \name Inspectors
+        //@{
+        Size samples() const { return samples_; }
+        Real weightSum() const { return weightSum_; }
+        Real mean() const {
+            QL_REQUIRE(weightSum_ > 0.0, "sampleWeight_=0, unsufficient");
+            return mean_;
+        }
+        Real variance() const {
+            QL_REQUIRE(weightSum_ > 0.0, "sampleWeight_=0, unsufficient");
+            QL_REQUIRE(samples_ > 1, "sample number <=1, unsufficient");
+            return m2_ / weightSum_ * samples_ / (samples_ - 1.0);
+        }
+        Real standardDeviation() const { return std::sqrt(variance()); }
+        Real errorEstimate() const {
+            return std::sqrt(variance() / samples_);
+        }
+        Real min() const {
+            QL_REQUIRE(samples_ > 0, "empty sample set");
+            return min_;
+        }
+        Real max() const {
+            QL_REQUIRE(samples_ > 0, "empty sample set");
+            return max_;
+        }
+        //! y-th percentile, interpolated in the histogram
+        Real percentile(Real y) const;
+        Size bins() const { return histogram_.size(); }
+        //@}
+
+        //! \name Modifiers
+        //@{
+        void add(Real value, Real weight = 1.0) {
+            Real weightSum = weightSum_ + weight;
+            Real delta = value - mean_;
+            Real r = delta * weight / weightSum;
+            mean_ += r;
+            m2_ += weightSum_ * delta * r;
+            weightSum_ = weightSum;
+            ++samples_;
+            min_ = std::min(min_, value);
+            max_ = std::max(max_, value);
+            histogram_[bin(value)] += weight;
+        }
+        template <class DataIterator>
+        void addSequence(DataIterator begin, DataIterator end) {
+            for (; begin != end; ++begin)
+                add(*begin);
+        }
+        //! adds the samples accumulated in \c other
+        void merge(const StreamingStatistics& other);
+        void reset() {
+            samples_ = 0;
+            weightSum_ = mean_ = m2_ = 0.0;
+            min_ = std::numeric_limits<Real>::max();
+            max_ = -std::numeric_limits<Real>::max();
+            std::fill(histogram_.begin(), histogram_.end(), 0.0);
+        }
+        //@}
+      private:
+        Size bin(Real value) const {
+            return Size(std::min(std::max((value - lower_) * scale_, 0.0),
+                                 lastBin_));
+        }
+        Real lower_, upper_, scale_, lastBin_;
+        Size samples_;
+        Real weightSum_, mean_, m2_, min_, max_;
+        std::vector<Real> histogram_;
+    };
+
+
+    // inline definitions
+
+    inline Real StreamingStatistics::percentile(Real y) const {
+        QL_REQUIRE(y > 0.0 && y <= 1.0,
+                   "percentile (" << y << ") must be in (0.0, 1.0]");
+        QL_REQUIRE(histogram_.size() > 1, "no histogram given");
+        QL_REQUIRE(weightSum_ > 0.0, "empty sample set");
+        Real target = y * weightSum_, cumulated = 0.0;
+        Real width = (upper_ - lower_) / histogram_.size();
+        for (Size i = 0; i < histogram_.size(); ++i) {
+            if (histogram_[i] > 0.0 && cumulated + histogram_[i] >= target) {
+                Real x = lower_ + (i + (target - cumulated) / histogram_[i]) * width;
+                return std::min(std::max(x, min_), max_);
+            }
+            cumulated += histogram_[i];
+        }
+        return max_;
+    }
+
+    inline void StreamingStatistics::merge(const StreamingStatistics& other) {
+        if (other.samples_ == 0)
+            return;
+        if (samples_ == 0) {
+            *this = other;
+            return;
+        }
+        QL_REQUIRE(lower_ == other.lower_ && upper_ == other.upper_ &&
+                   histogram_.size() == other.histogram_.size(),
+                   "statistics with different histograms cannot be merged");
+        Real weightSum = weightSum_ + other.weightSum_;
+        Real delta = other.mean_ - mean_;
+        mean_ += delta * other.weightSum_ / weightSum;
+        m2_ += other.m2_ + delta * delta * weightSum_ * other.weightSum_ / weightSum;
+        weightSum_ = weightSum;
+        samples_ += other.samples_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+        for (Size i = 0; i < histogram_.size(); ++i)
+            histogram_[i] += other.histogram_[i];
+    }
+
+} // namespace QuantLib
+
+#endif
@@ -0,0 +1,212 @@
+// Allocations sur le tas pendant l'échantillonnage des moteurs _2.
+//
+//   make test-alloc
+//
+// Ce programme est la seule unité de traduction qui définit
+// QL_MC_COUNT_HEAP_ALLOCATIONS : l'operator new global y est remplacé
+// (voir mcallocationcounter.hpp) et sampleAllocations() compte vraiment.
+// Pour chaque moteur et chaque mode, à nombre de tirages fixé, on vérifie
+// qu'aucun chemin n'alloue ; le code de retour est le nombre d'échecs.
+#define QL_MC_COUNT_HEAP_ALLOCATIONS
+
+#include <ql/qldefines.hpp>
+#ifdef BOOST_MSVC
+#  include <ql/auto_link.hpp>
+#endif
+
+#include "../mceuropeanengine.hpp"
+#include "../mc_discr_arith_av_strike.hpp"
+#include "../mcbarrierengine.hpp"
+
+#include <ql/instruments/europeanoption.hpp>
+#include <ql/instruments/asianoption.hpp>
+#include <ql/instruments/barrieroption.hpp>
+#include <ql/instruments/payoffs.hpp>
+#include <ql/exercise.hpp>
+
+#include <ql/termstructures/yield/zerocurve.hpp>
+#include <ql/termstructures/volatility/equityfx/blackvariancecurve.hpp>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace QuantLib;
+
+namespace {
+
+    const Size samples = 10000;
+    const Size steps = 10;
+    const BigNatural mcSeed = 42;
+
+    // prix de l'instrument avec le moteur, puis allocations du moteur
+    template <class Engine>
+    bool check(const std::string& name,
+               Instrument& instrument,
+               const ext::shared_ptr<PricingEngine>& engine) {
+        auto e = ext::dynamic_pointer_cast<Engine>(engine);
+        QL_REQUIRE(e, name << ": unexpected engine type");
+        instrument.setPricingEngine(engine);
+        Real npv = instrument.NPV();
+        Size allocations = e->sampleAllocations();
+        std::cout << std::setw(40) << std::left << name
+                  << std::setw(15) << npv
+                  << allocations
+                  << (allocations == 0 ? "" : "  <- FAILED") << std::endl;
+        return allocations == 0;
+    }
+
+}
+
+int main() {
+
+    try {
+        // même marché et mêmes options que main.cpp
+        Date today(24, February, 2022);
+        Settings::instance().evaluationDate() = today;
+
+        Handle<Quote> underlyingH(ext::make_shared<SimpleQuote>(36.0));
+        DayCounter dayCounter = Actual365Fixed();
+        Handle<YieldTermStructure> riskFreeRate(
+            ext::make_shared<ZeroCurve>(
+                std::vector<Date>{today, today + 6*Months},
+                std::vector<Rate>{0.01, 0.015},
+                dayCounter));
+        Handle<BlackVolTermStructure> volatility(
+            ext::make_shared<BlackVarianceCurve>(
+                today,
+                std::vector<Date>{today + 3*Months, today + 6*Months},
+                std::vector<Volatility>{0.20, 0.25},
+                dayCounter));
+        auto process = ext::make_shared<BlackScholesProcess>(
+            underlyingH, riskFreeRate, volatility);
+
+        Date maturity(24, May, 2022);
+        auto exercise = ext::make_shared<EuropeanExercise>(maturity);
+        auto payoff = ext::make_shared<PlainVanillaPayoff>(Option::Put, 40.0);
+
+        EuropeanOption european(payoff, exercise);
+        DiscreteAveragingAsianOption asian(
+            Average::Arithmetic,
+            {
+                Date(4,  March, 2022), Date(14, March, 2022), Date(24, March, 2022),
+                Date(4,  April, 2022), Date(14, April, 2022), Date(24, April, 2022),
+                Date(4,  May, 2022),   Date(14, May, 2022),   Date(24, May, 2022)
+            },
+            payoff, exercise);
+        BarrierOption barrier(Barrier::UpIn, 40, 0, payoff, exercise);
+
+        std::vector<MarketScenario> scenarios(2);
+        scenarios[0].spotShift = 0.01;
+        scenarios[1].volatilityShift = 0.01;
+
+        typedef MCEuropeanEngine_2<PseudoRandom, Statistics> european_engine;
+        typedef MCDiscreteArithmeticASEngine_2<PseudoRandom, Statistics> asian_engine;
+        typedef MCBarrierEngine_2<PseudoRandom, Statistics> barrier_engine;
+        typedef MakeMCEuropeanEngine_2<PseudoRandom, Statistics> make_european;
+        typedef MakeMCDiscreteArithmeticASEngine_2<PseudoRandom, Statistics> make_asian;
+        typedef MakeMCBarrierEngine_2<PseudoRandom, Statistics> make_barrier;
+
+        std::cout << std::setw(40) << std::left << "engine / mode"
+                  << std::setw(15) << "NPV" << "allocations" << std::endl;
+        std::cout << std::string(70, '-') << std::endl;
+
+        Size failures = 0;
+        auto expect = [&](bool ok) { if (!ok) ++failures; };
+
+        // ---------------------------------------------------------------
+        // European
+        // ---------------------------------------------------------------
+        auto makeEuropean = [&]() {
+            return make_european(process)
+                .withSteps(steps).withSamples(samples).withSeed(mcSeed);
+        };
+        expect(check<european_engine>("European, curves", european,
+            makeEuropean().withConstantParameters(false)));
+        expect(check<european_engine>("European, curves, 2 threads", european,
+            makeEuropean().withConstantParameters(false).withThreads(2)));
+        expect(check<european_engine>("European, constant", european,
+            makeEuropean().withConstantParameters(true)));
+        expect(check<european_engine>("European, constant, antithetic", european,
+            makeEuropean().withConstantParameters(true).withAntitheticVariate()));
+        expect(check<european_engine>("European, piecewise", european,
+            makeEuropean().withConstantParameters(false)
+                          .withPiecewiseConstantParameters()));
+        expect(check<european_engine>("European, terminal", european,
+            makeEuropean().withConstantParameters(true).withTerminalSampling()));
+        expect(check<european_engine>("European, batch", european,
+            makeEuropean().withConstantParameters(true).withBatchSize(1024)));
+        expect(check<european_engine>("European, batch, float", european,
+            makeEuropean().withConstantParameters(true).withBatchSize(1024)
+                          .withSinglePrecision()));
+        expect(check<european_engine>("European, greeks", european,
+            makeEuropean().withConstantParameters(true).withGreeks()));
+        expect(check<european_engine>("European, scenarios", european,
+            makeEuropean().withConstantParameters(true).withScenarios(scenarios)));
+        expect(check<MCEuropeanEngine_2<PseudoRandom, StreamingStatistics> >(
+            "European, constant, streaming", european,
+            MakeMCEuropeanEngine_2<PseudoRandom, StreamingStatistics>(process)
+                .withSteps(steps).withSamples(samples).withSeed(mcSeed)
+                .withConstantParameters(true)));
+
+        // ---------------------------------------------------------------
+        // Asian
+        // ---------------------------------------------------------------
+        auto makeAsian = [&]() {
+            return make_asian(process).withSamples(samples).withSeed(mcSeed);
+        };
+        expect(check<asian_engine>("Asian, curves", asian,
+            makeAsian().withConstantParameters(false)));
+        expect(check<asian_engine>("Asian, curves, 2 threads", asian,
+            makeAsian().withConstantParameters(false).withThreads(2)));
+        expect(check<asian_engine>("Asian, constant", asian,
+            makeAsian().withConstantParameters(true)));
+        expect(check<asian_engine>("Asian, piecewise", asian,
+            makeAsian().withConstantParameters(false)
+                       .withPiecewiseConstantParameters()));
+        expect(check<asian_engine>("Asian, control variate", asian,
+            makeAsian().withConstantParameters(true).withControlVariate()));
+        expect(check<asian_engine>("Asian, batch", asian,
+            makeAsian().withConstantParameters(true).withBatchSize(1024)));
+        expect(check<asian_engine>("Asian, greeks", asian,
+            makeAsian().withConstantParameters(true).withGreeks()));
+        expect(check<asian_engine>("Asian, scenarios", asian,
+            makeAsian().withConstantParameters(true).withScenarios(scenarios)));
+
+        // ---------------------------------------------------------------
+        // Barrier
+        // ---------------------------------------------------------------
+        auto makeBarrier = [&]() {
+            return make_barrier(process)
+                .withSteps(steps).withSamples(samples).withSeed(mcSeed);
+        };
+        expect(check<barrier_engine>("Barrier, curves", barrier,
+            makeBarrier().withConstantParameters(false)));
+        expect(check<barrier_engine>("Barrier, curves, biased", barrier,
+            makeBarrier().withConstantParameters(false).withBias()));
+        expect(check<barrier_engine>("Barrier, curves, 2 threads", barrier,
+            makeBarrier().withConstantParameters(false).withThreads(2)));
+        expect(check<barrier_engine>("Barrier, constant", barrier,
+            makeBarrier().withConstantParameters(true)));
+        expect(check<barrier_engine>("Barrier, piecewise", barrier,
+            makeBarrier().withConstantParameters(false)
+                         .withPiecewiseConstantParameters()));
+        expect(check<barrier_engine>("Barrier, batch", barrier,
+            makeBarrier().withConstantParameters(true).withBatchSize(1024)));
+        expect(check<barrier_engine>("Barrier, scenarios", barrier,
+            makeBarrier().withConstantParameters(true).withScenarios(scenarios)));
+
+        std::cout << std::string(70, '-') << std::endl;
+        std::cout << (failures == 0 ? "no allocation while sampling"
+                                    : "allocations while sampling")
+                  << std::endl;
+        return int(failures);
+
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    } catch (...) {
+        std::cerr << "unknown error" << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,79 @@
+// Pondération par la probabilité de survie de MCBarrierEngine_2.
+//
+//   make test
+//
+// Sur un marché plat, le pont brownien rend la surveillance continue
+// exacte : le pricer pondéré (process constant) et le pricer non biaisé
+// à tirages uniformes (courbes) doivent retrouver AnalyticBarrierEngine
+// aux erreurs près, le pondéré avec une erreur plus petite.  Le pricer
+// biaisé, qui ne regarde que les noeuds, doit rater des franchissements :
+// pour une option activante, son prix est trop bas.
+#include "market.hpp"
+#include "../mcbarrierengine.hpp"
+
+#include <ql/instruments/barrieroption.hpp>
+#include <ql/instruments/payoffs.hpp>
+#include <ql/exercise.hpp>
+#include <ql/pricingengines/barrier/analyticbarrierengine.hpp>
+
+using namespace QuantLib;
+
+int main() {
+
+    try {
+        std::cout << "Barrier survival weights" << std::endl << std::endl;
+
+        Handle<Quote> spot(ext::make_shared<SimpleQuote>(36.0));
+        Handle<Quote> volatility(ext::make_shared<SimpleQuote>(0.20));
+        auto process = tests::flatProcess(spot, volatility);
+
+        Date maturity(24, May, 2022);
+        BarrierOption barrier(
+            Barrier::UpIn, 40, 0,
+            ext::make_shared<PlainVanillaPayoff>(Option::Put, 40.0),
+            ext::make_shared<EuropeanExercise>(maturity));
+
+        barrier.setPricingEngine(ext::make_shared<AnalyticBarrierEngine>(process));
+        Real analytic = barrier.NPV();
+
+        typedef MakeMCBarrierEngine_2<PseudoRandom, Statistics> make_barrier;
+        auto makeBarrier = [&]() {
+            return make_barrier(process)
+                .withSteps(10).withSamples(100000).withSeed(42);
+        };
+
+        tests::printHeader();
+        Size failures = 0;
+
+        barrier.setPricingEngine(makeBarrier().withConstantParameters(true));
+        Real weighted = barrier.NPV(), weightedError = barrier.errorEstimate();
+        if (!tests::checkClose("survival weights vs analytic", weighted,
+                               analytic, tests::sigmas * weightedError))
+            ++failures;
+
+        barrier.setPricingEngine(makeBarrier().withConstantParameters(false));
+        Real unbiased = barrier.NPV(), unbiasedError = barrier.errorEstimate();
+        if (!tests::checkClose("random crossings vs analytic", unbiased,
+                               analytic, tests::sigmas * unbiasedError))
+            ++failures;
+        if (!tests::checkBelow("survival weights error", weightedError,
+                               unbiasedError))
+            ++failures;
+
+        barrier.setPricingEngine(
+            makeBarrier().withConstantParameters(false).withBias());
+        Real biased = barrier.NPV(), biasedError = barrier.errorEstimate();
+        if (!tests::checkBelow("biased, knock-in", biased,
+                               analytic - tests::sigmas * biasedError))
+            ++failures;
+
+        return tests::summary(failures);
+
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    } catch (...) {
+        std::cerr << "unknown error" << std::endl;
+        return 1;
+    }
+}
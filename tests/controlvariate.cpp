@@ -0,0 +1,80 @@
+// Variable de contrôle géométrique de MCDiscreteArithmeticASEngine_2.
+//
+//   make test
+//
+// Dans chaque mode (process constant, constant par intervalle, courbes),
+// le prix avec variable de contrôle doit rester dans les erreurs du prix
+// sans variable de contrôle, tiré avec une autre graine, et son erreur
+// doit être plus petite.
+#include "market.hpp"
+#include "../mc_discr_arith_av_strike.hpp"
+
+#include <ql/instruments/asianoption.hpp>
+#include <ql/instruments/payoffs.hpp>
+#include <ql/exercise.hpp>
+
+using namespace QuantLib;
+
+int main() {
+
+    try {
+        std::cout << "Asian control variate" << std::endl << std::endl;
+
+        Handle<Quote> spot(ext::make_shared<SimpleQuote>(36.0));
+        auto process = tests::curveProcess(spot);
+
+        Date maturity(24, May, 2022);
+        auto exercise = ext::make_shared<EuropeanExercise>(maturity);
+        auto payoff = ext::make_shared<PlainVanillaPayoff>(Option::Put, 40.0);
+        DiscreteAveragingAsianOption asian(
+            Average::Arithmetic,
+            {
+                Date(4,  March, 2022), Date(14, March, 2022), Date(24, March, 2022),
+                Date(4,  April, 2022), Date(14, April, 2022), Date(24, April, 2022),
+                Date(4,  May, 2022),   Date(14, May, 2022),   Date(24, May, 2022)
+            },
+            payoff, exercise);
+
+        typedef MakeMCDiscreteArithmeticASEngine_2<PseudoRandom, Statistics> make_asian;
+        const Size samples = 100000;
+
+        tests::printHeader();
+        Size failures = 0;
+
+        struct Mode {
+            std::string name;
+            bool constant, piecewise;
+        };
+        for (const Mode& mode : {Mode{"constant", true, false},
+                                 Mode{"piecewise", false, true},
+                                 Mode{"curves", false, false}}) {
+            auto makeAsian = [&](BigNatural seed) {
+                return make_asian(process)
+                    .withSamples(samples).withSeed(seed)
+                    .withConstantParameters(mode.constant)
+                    .withPiecewiseConstantParameters(mode.piecewise);
+            };
+            asian.setPricingEngine(makeAsian(42));
+            Real plain = asian.NPV(), plainError = asian.errorEstimate();
+            asian.setPricingEngine(makeAsian(43).withControlVariate());
+            Real controlled = asian.NPV(), controlledError = asian.errorEstimate();
+
+            if (!tests::checkConsistent("control variate, " + mode.name,
+                                        controlled, controlledError,
+                                        plain, plainError))
+                ++failures;
+            if (!tests::checkBelow("control variate error, " + mode.name,
+                                   controlledError, plainError))
+                ++failures;
+        }
+
+        return tests::summary(failures);
+
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    } catch (...) {
+        std::cerr << "unknown error" << std::endl;
+        return 1;
+    }
+}
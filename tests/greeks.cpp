@@ -0,0 +1,120 @@
+// Grecques pathwise et par rapport de vraisemblance des moteurs _2.
+//
+//   make test
+//
+// Sur un marché plat (le process constant est alors exact), le delta, le
+// gamma et le vega calculés avec le prix doivent être, aux erreurs près,
+// les différences finies du prix recalculé avec le spot et la volatilité
+// décalés, sur les mêmes tirages (même graine).
+#include "market.hpp"
+#include "../mceuropeanengine.hpp"
+#include "../mc_discr_arith_av_strike.hpp"
+
+#include <ql/instruments/europeanoption.hpp>
+#include <ql/instruments/asianoption.hpp>
+#include <ql/instruments/payoffs.hpp>
+#include <ql/exercise.hpp>
+
+using namespace QuantLib;
+
+namespace {
+
+    const Size samples = 100000;
+    const BigNatural mcSeed = 42;
+    // décalages du spot et de la volatilité
+    const Real spotBump = 0.5, volatilityBump = 0.01;
+
+    // grecques du moteur contre différences finies centrées du prix ;
+    // makeEngine(greeks) construit le moteur, toujours avec la même graine
+    template <class EngineFactory>
+    Size checkGreeks(const std::string& name,
+                     OneAssetOption& option,
+                     const ext::shared_ptr<SimpleQuote>& spot,
+                     const ext::shared_ptr<SimpleQuote>& volatility,
+                     const EngineFactory& makeEngine) {
+        option.setPricingEngine(makeEngine(true));
+        Real delta = option.delta(), gamma = option.gamma(), vega = option.vega();
+        Real deltaError = option.result<Real>("deltaErrorEstimate");
+        Real gammaError = option.result<Real>("gammaErrorEstimate");
+        Real vegaError = option.result<Real>("vegaErrorEstimate");
+
+        option.setPricingEngine(makeEngine(false));
+        auto price = [&](const ext::shared_ptr<SimpleQuote>& quote, Real shift) {
+            Real value = quote->value();
+            quote->setValue(value + shift);
+            Real npv = option.NPV();
+            quote->setValue(value);
+            return npv;
+        };
+        Real p0 = option.NPV();
+        Real pUp = price(spot, spotBump), pDown = price(spot, -spotBump);
+        Real vUp = price(volatility, volatilityBump);
+        Real vDown = price(volatility, -volatilityBump);
+
+        Size failures = 0;
+        if (!tests::checkClose(name + ", delta", delta,
+                               (pUp - pDown) / (2.0 * spotBump),
+                               tests::sigmas * deltaError))
+            ++failures;
+        if (!tests::checkClose(name + ", gamma", gamma,
+                               (pUp - 2.0 * p0 + pDown) / (spotBump * spotBump),
+                               tests::sigmas * gammaError))
+            ++failures;
+        if (!tests::checkClose(name + ", vega", vega,
+                               (vUp - vDown) / (2.0 * volatilityBump),
+                               tests::sigmas * vegaError))
+            ++failures;
+        return failures;
+    }
+
+}
+
+int main() {
+
+    try {
+        std::cout << "Greeks vs bump and reprice" << std::endl << std::endl;
+
+        auto spot = ext::make_shared<SimpleQuote>(36.0);
+        auto volatility = ext::make_shared<SimpleQuote>(0.20);
+        auto process = tests::flatProcess(Handle<Quote>(spot),
+                                          Handle<Quote>(volatility));
+
+        Date maturity(24, May, 2022);
+        auto exercise = ext::make_shared<EuropeanExercise>(maturity);
+        auto payoff = ext::make_shared<PlainVanillaPayoff>(Option::Put, 40.0);
+        EuropeanOption european(payoff, exercise);
+        DiscreteAveragingAsianOption asian(
+            Average::Arithmetic,
+            {
+                Date(4,  March, 2022), Date(14, March, 2022), Date(24, March, 2022),
+                Date(4,  April, 2022), Date(14, April, 2022), Date(24, April, 2022),
+                Date(4,  May, 2022),   Date(14, May, 2022),   Date(24, May, 2022)
+            },
+            payoff, exercise);
+
+        tests::printHeader();
+        Size failures = 0;
+
+        failures += checkGreeks("European", european, spot, volatility,
+            [&](bool greeks) -> ext::shared_ptr<PricingEngine> {
+                return MakeMCEuropeanEngine_2<PseudoRandom, Statistics>(process)
+                    .withSteps(10).withSamples(samples).withSeed(mcSeed)
+                    .withConstantParameters(true).withGreeks(greeks);
+            });
+        failures += checkGreeks("Asian", asian, spot, volatility,
+            [&](bool greeks) -> ext::shared_ptr<PricingEngine> {
+                return MakeMCDiscreteArithmeticASEngine_2<PseudoRandom, Statistics>(process)
+                    .withSamples(samples).withSeed(mcSeed)
+                    .withConstantParameters(true).withGreeks(greeks);
+            });
+
+        return tests::summary(failures);
+
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    } catch (...) {
+        std::cerr << "unknown error" << std::endl;
+        return 1;
+    }
+}
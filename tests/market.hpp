@@ -0,0 +1,146 @@
+// Marché et contrôles communs aux tests de comportement (make test).
+//
+// Chaque programme de tests/ compare un mode des moteurs _2 à une
+// référence (autre moteur, autre mode, formule fermée) et renvoie le
+// nombre d'échecs.  Les écarts sont jugés en nombre d'erreurs Monte
+// Carlo ; les graines sont fixées, les résultats sont reproductibles.
+#ifndef QL_TESTS_MARKET_HPP
+#define QL_TESTS_MARKET_HPP
+
+#include <ql/qldefines.hpp>
+#ifdef BOOST_MSVC
+#  include <ql/auto_link.hpp>
+#endif
+
+#include <ql/errors.hpp>
+#include <ql/processes/blackscholesprocess.hpp>
+#include <ql/quotes/simplequote.hpp>
+#include <ql/settings.hpp>
+#include <ql/termstructures/yield/flatforward.hpp>
+#include <ql/termstructures/yield/zerocurve.hpp>
+#include <ql/termstructures/volatility/equityfx/blackconstantvol.hpp>
+#include <ql/termstructures/volatility/equityfx/blackvariancecurve.hpp>
+#include <ql/time/calendars/nullcalendar.hpp>
+#include <ql/time/daycounters/actual365fixed.hpp>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace QuantLib {
+
+    namespace tests {
+
+        // écart toléré, en erreurs Monte Carlo
+        const Real sigmas = 4.0;
+
+        //! même marché que main.cpp : taux et volatilité par morceaux
+        /*! Fixe aussi la date d'évaluation au 24 février 2022. */
+        inline ext::shared_ptr<BlackScholesProcess> curveProcess(
+                                          const Handle<Quote>& spot) {
+            Date today(24, February, 2022);
+            Settings::instance().evaluationDate() = today;
+            DayCounter dayCounter = Actual365Fixed();
+            Handle<YieldTermStructure> riskFreeRate(
+                ext::make_shared<ZeroCurve>(
+                    std::vector<Date>{today, today + 6*Months},
+                    std::vector<Rate>{0.01, 0.015},
+                    dayCounter));
+            Handle<BlackVolTermStructure> volatility(
+                ext::make_shared<BlackVarianceCurve>(
+                    today,
+                    std::vector<Date>{today + 3*Months, today + 6*Months},
+                    std::vector<Volatility>{0.20, 0.25},
+                    dayCounter));
+            return ext::make_shared<BlackScholesProcess>(
+                spot, riskFreeRate, volatility);
+        }
+
+        //! taux et volatilité constants, la volatilité lue dans une cotation
+        /*! Le process constant extrait par les moteurs est alors exactement
+            le process du marché : pas d'écart dû à l'extraction.
+        */
+        inline ext::shared_ptr<BlackScholesProcess> flatProcess(
+                                          const Handle<Quote>& spot,
+                                          const Handle<Quote>& volatility) {
+            Date today(24, February, 2022);
+            Settings::instance().evaluationDate() = today;
+            DayCounter dayCounter = Actual365Fixed();
+            Handle<YieldTermStructure> riskFreeRate(
+                ext::make_shared<FlatForward>(today, 0.01, dayCounter));
+            Handle<BlackVolTermStructure> blackVolatility(
+                ext::make_shared<BlackConstantVol>(
+                    today, NullCalendar(), volatility, dayCounter));
+            return ext::make_shared<BlackScholesProcess>(
+                spot, riskFreeRate, blackVolatility);
+        }
+
+        inline void printHeader() {
+            std::cout << std::setw(45) << std::left << "check"
+                      << std::setw(15) << "value"
+                      << std::setw(15) << "reference"
+                      << "tolerance" << std::endl;
+            std::cout << std::string(85, '-') << std::endl;
+        }
+
+        //! value à moins de tolerance de reference
+        inline bool checkClose(const std::string& name, Real value,
+                               Real reference, Real tolerance) {
+            bool ok = std::fabs(value - reference) <= tolerance;
+            std::cout << std::setw(45) << std::left << name
+                      << std::setw(15) << value
+                      << std::setw(15) << reference
+                      << tolerance
+                      << (ok ? "" : "  <- FAILED") << std::endl;
+            return ok;
+        }
+
+        //! écart de deux estimations indépendantes, en erreurs combinées
+        inline bool checkConsistent(const std::string& name,
+                                    Real value, Real error,
+                                    Real reference, Real referenceError) {
+            return checkClose(name, value, reference,
+                              sigmas * std::sqrt(error * error +
+                                                 referenceError * referenceError));
+        }
+
+        //! value strictement sous bound
+        inline bool checkBelow(const std::string& name, Real value, Real bound) {
+            bool ok = value < bound;
+            std::cout << std::setw(45) << std::left << name
+                      << std::setw(15) << value
+                      << std::setw(15) << bound
+                      << "below"
+                      << (ok ? "" : "  <- FAILED") << std::endl;
+            return ok;
+        }
+
+        //! f() doit lever une exception QuantLib
+        template <class F>
+        bool checkThrows(const std::string& name, const F& f) {
+            bool ok = false;
+            try {
+                f();
+            } catch (Error&) {
+                ok = true;
+            }
+            std::cout << std::setw(45) << std::left << name
+                      << std::setw(30) << "" << "throws"
+                      << (ok ? "" : "  <- FAILED") << std::endl;
+            return ok;
+        }
+
+        inline int summary(Size failures) {
+            std::cout << std::string(85, '-') << std::endl;
+            std::cout << (failures == 0 ? "all checks passed"
+                                        : "some checks failed")
+                      << std::endl << std::endl;
+            return int(failures);
+        }
+
+    }
+
+}
+
+#endif
@@ -0,0 +1,91 @@
+// MLMC de MCBarrierEngine_2 comparé à la simulation sur un seul niveau.
+//
+//   make test
+//
+// L'estimateur télescopique a l'espérance du niveau le plus fin : avec
+// le pricer pondéré (process constant) comme avec le pricer biaisé
+// (courbes), le prix MLMC doit rester dans les erreurs du prix calculé
+// directement sur la grille fine, tiré avec une autre graine.  La
+// factory doit refuser une grille fine qui ne se grossit pas levels-1
+// fois.
+#include "market.hpp"
+#include "../mcbarrierengine.hpp"
+
+#include <ql/instruments/barrieroption.hpp>
+#include <ql/instruments/payoffs.hpp>
+#include <ql/exercise.hpp>
+
+using namespace QuantLib;
+
+int main() {
+
+    try {
+        std::cout << "Multi-level barrier" << std::endl << std::endl;
+
+        Handle<Quote> spot(ext::make_shared<SimpleQuote>(36.0));
+        auto process = tests::curveProcess(spot);
+
+        Date maturity(24, May, 2022);
+        BarrierOption barrier(
+            Barrier::UpIn, 40, 0,
+            ext::make_shared<PlainVanillaPayoff>(Option::Put, 40.0),
+            ext::make_shared<EuropeanExercise>(maturity));
+
+        typedef MakeMCBarrierEngine_2<PseudoRandom, Statistics> make_barrier;
+        const Size steps = 40, levels = 3, samples = 100000;
+        auto makeBarrier = [&](BigNatural seed) {
+            return make_barrier(process)
+                .withSteps(steps).withSamples(samples).withSeed(seed);
+        };
+
+        tests::printHeader();
+        Size failures = 0;
+
+        struct Mode {
+            std::string name;
+            bool constant, biased;
+        };
+        for (const Mode& mode : {Mode{"constant", true, false},
+                                 Mode{"curves, biased", false, true}}) {
+            barrier.setPricingEngine(
+                makeBarrier(42).withConstantParameters(mode.constant)
+                               .withBias(mode.biased));
+            Real single = barrier.NPV(), singleError = barrier.errorEstimate();
+            barrier.setPricingEngine(
+                makeBarrier(43).withConstantParameters(mode.constant)
+                               .withBias(mode.biased)
+                               .withMultilevel(levels));
+            Real multilevel = barrier.NPV();
+            Real multilevelError = barrier.errorEstimate();
+
+            if (!tests::checkConsistent("MLMC vs single level, " + mode.name,
+                                        multilevel, multilevelError,
+                                        single, singleError))
+                ++failures;
+            auto levelSamples =
+                barrier.result<std::vector<Size> >("levelSamples");
+            if (!tests::checkClose("levels sampled, " + mode.name,
+                                   Real(levelSamples.size()), Real(levels), 0.0))
+                ++failures;
+        }
+
+        // 30 pas : le deuxième niveau grossier n'existe pas
+        if (!tests::checkThrows("30 steps over 3 levels", [&]() {
+                ext::shared_ptr<PricingEngine> engine =
+                    make_barrier(process)
+                        .withSteps(30).withSamples(samples)
+                        .withConstantParameters(true)
+                        .withMultilevel(levels);
+            }))
+            ++failures;
+
+        return tests::summary(failures);
+
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    } catch (...) {
+        std::cerr << "unknown error" << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,121 @@
+// StreamingStatistics comparé à Statistics de QuantLib.
+//
+//   make test
+//
+// Sur un même échantillon pondéré, la moyenne, la variance, l'erreur,
+// le min et le max doivent être ceux de Statistics à l'arrondi près,
+// y compris après la fusion de deux moitiés de l'échantillon ; les
+// percentiles à la largeur d'une case de l'histogramme près.  Enfin
+// MCEuropeanEngine_2 doit donner le même prix et la même erreur avec les
+// deux accumulateurs.
+#include "market.hpp"
+#include "../streamingstatistics.hpp"
+#include "../mceuropeanengine.hpp"
+
+#include <ql/instruments/europeanoption.hpp>
+#include <ql/instruments/payoffs.hpp>
+#include <ql/exercise.hpp>
+#include <ql/math/randomnumbers/mt19937uniformrng.hpp>
+#include <ql/math/statistics/statistics.hpp>
+#include <algorithm>
+#include <sstream>
+
+using namespace QuantLib;
+
+namespace {
+
+    // à l'arrondi près, relativement à la référence
+    Real rounding(Real reference) {
+        return 1.0e-10 * std::max(1.0, std::fabs(reference));
+    }
+
+    template <class Stats>
+    Size compare(const std::string& name, const Stats& stats,
+                 const Statistics& reference) {
+        Size failures = 0;
+        auto expect = [&](const std::string& what, Real value, Real expected) {
+            if (!tests::checkClose(name + ", " + what, value, expected,
+                                   rounding(expected)))
+                ++failures;
+        };
+        expect("mean", stats.mean(), reference.mean());
+        expect("variance", stats.variance(), reference.variance());
+        expect("error estimate", stats.errorEstimate(), reference.errorEstimate());
+        expect("min", stats.min(), reference.min());
+        expect("max", stats.max(), reference.max());
+        return failures;
+    }
+
+}
+
+int main() {
+
+    try {
+        std::cout << "Streaming statistics" << std::endl << std::endl;
+        tests::printHeader();
+        Size failures = 0;
+
+        // échantillon exponentiel de moyenne 1, poids dans [0.5, 1.5)
+        const Size samples = 100000, half = 40000;
+        const Real lower = 0.0, upper = 10.0;
+        const Size bins = 1000;
+        MersenneTwisterUniformRng rng(42);
+        Statistics reference;
+        StreamingStatistics whole(lower, upper, bins);
+        StreamingStatistics first(lower, upper, bins), second(lower, upper, bins);
+        for (Size i = 0; i < samples; ++i) {
+            Real value = -std::log(1.0 - rng.nextReal());
+            Real weight = 0.5 + rng.nextReal();
+            reference.add(value, weight);
+            whole.add(value, weight);
+            (i < half ? first : second).add(value, weight);
+        }
+        first.merge(second);
+
+        failures += compare("streaming", whole, reference);
+        failures += compare("merged", first, reference);
+
+        Real width = (upper - lower) / bins;
+        for (Real y : {0.05, 0.5, 0.95}) {
+            std::ostringstream name;
+            name << "percentile " << y;
+            if (!tests::checkClose(name.str(), whole.percentile(y),
+                                   reference.percentile(y), width))
+                ++failures;
+        }
+
+        // même moteur, mêmes tirages, deux accumulateurs
+        Handle<Quote> spot(ext::make_shared<SimpleQuote>(36.0));
+        auto process = tests::curveProcess(spot);
+        Date maturity(24, May, 2022);
+        EuropeanOption european(
+            ext::make_shared<PlainVanillaPayoff>(Option::Put, 40.0),
+            ext::make_shared<EuropeanExercise>(maturity));
+
+        european.setPricingEngine(
+            MakeMCEuropeanEngine_2<PseudoRandom, Statistics>(process)
+                .withSteps(10).withSamples(samples).withSeed(42)
+                .withConstantParameters(true));
+        Real npv = european.NPV(), error = european.errorEstimate();
+        european.setPricingEngine(
+            MakeMCEuropeanEngine_2<PseudoRandom, StreamingStatistics>(process)
+                .withSteps(10).withSamples(samples).withSeed(42)
+                .withConstantParameters(true));
+        if (!tests::checkClose("European engine, NPV", european.NPV(),
+                               npv, rounding(npv)))
+            ++failures;
+        if (!tests::checkClose("European engine, error estimate",
+                               european.errorEstimate(), error,
+                               rounding(error)))
+            ++failures;
+
+        return tests::summary(failures);
+
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    } catch (...) {
+        std::cerr << "unknown error" << std::endl;
+        return 1;
+    }
+}
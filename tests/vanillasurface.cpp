@@ -0,0 +1,77 @@
+// Surface strike/maturité de MCVanillaSurfacePricer.
+//
+//   make test
+//
+// Chaque entrée de la surface, tirée sur un seul jeu de chemins, doit
+// rester dans les erreurs du prix de la même option calculé seul par
+// MCEuropeanEngine_2 (process constant, autre graine pour chaque option).
+#include "market.hpp"
+#include "../mceuropeanengine.hpp"
+#include "../mcvanillasurface.hpp"
+
+#include <ql/instruments/europeanoption.hpp>
+#include <ql/instruments/payoffs.hpp>
+#include <ql/exercise.hpp>
+#include <sstream>
+
+using namespace QuantLib;
+
+int main() {
+
+    try {
+        std::cout << "Vanilla surface" << std::endl << std::endl;
+
+        Handle<Quote> spot(ext::make_shared<SimpleQuote>(36.0));
+        auto process = tests::curveProcess(spot);
+
+        const Size samples = 100000;
+        std::vector<Date> maturities = {Date(24, May, 2022), Date(24, July, 2022)};
+        std::vector<ext::shared_ptr<PlainVanillaPayoff> > payoffs = {
+            ext::make_shared<PlainVanillaPayoff>(Option::Put, 36.0),
+            ext::make_shared<PlainVanillaPayoff>(Option::Put, 40.0),
+            ext::make_shared<PlainVanillaPayoff>(Option::Call, 40.0),
+            ext::make_shared<PlainVanillaPayoff>(Option::Call, 44.0)
+        };
+
+        VanillaSurfaceResults surface =
+            MCVanillaSurfacePricer<PseudoRandom, StreamingStatistics>(
+                process, maturities, payoffs)
+            .withSamples(samples).withSeed(42)
+            .calculate();
+
+        tests::printHeader();
+        Size failures = 0;
+
+        BigNatural seed = 43;
+        for (Size m = 0; m < maturities.size(); ++m) {
+            for (Size k = 0; k < payoffs.size(); ++k) {
+                EuropeanOption option(
+                    payoffs[k], ext::make_shared<EuropeanExercise>(maturities[m]));
+                // process constant : un pas suffit
+                option.setPricingEngine(
+                    MakeMCEuropeanEngine_2<PseudoRandom, Statistics>(process)
+                        .withSteps(1).withSamples(samples).withSeed(seed++)
+                        .withConstantParameters(true));
+                std::ostringstream name;
+                name << maturities[m] << ", "
+                     << (payoffs[k]->optionType() == Option::Call ? "call " : "put ")
+                     << payoffs[k]->strike();
+                if (!tests::checkConsistent(name.str(),
+                                            surface.value[m][k],
+                                            surface.errorEstimate[m][k],
+                                            option.NPV(),
+                                            option.errorEstimate()))
+                    ++failures;
+            }
+        }
+
+        return tests::summary(failures);
+
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    } catch (...) {
+        std::cerr << "unknown error" << std::endl;
+        return 1;
+    }
+}